@@ -0,0 +1,189 @@
+#include "batch.h"
+#include "ledger.h"
+
+#include <charconv>
+#include <climits>
+#include <cstring>
+
+//#define DEBUG
+
+/* @brief Skips spaces, tabs and carriage returns inside a line.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static const char* SkipBlanks(const char* p, const char* end) {
+
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+
+
+
+/* @brief Parses the bytes of a command file into a list of commands.
+ *
+ * @param "p" [in] First byte of the file.
+ *
+ * @param "end" [in] One past the last byte of the file.
+ *
+ * @param "commands" [out] Receives one batchCommand per non blank, non comment line. Lines that do not follow
+ *                         "C <type> <index>" or "D <type>" are kept with op '?' so that they are reported with their line number.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void BatchParse(const char* p, const char* end, vector<batchCommand>& commands) {
+
+    long long line = 0;
+
+    while (p < end) {
+
+        const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+        if (lineEnd == NULL) lineEnd = end;
+        line++;
+
+        const char* q = SkipBlanks(p, lineEnd);
+
+        if (q != lineEnd && *q != '#') {
+
+            batchCommand command('?', '\0', 0, line);
+
+            char op = *q++;
+            q = SkipBlanks(q, lineEnd);
+
+            if (q != lineEnd) {
+
+                char buildType = *q++;
+                q = SkipBlanks(q, lineEnd);
+
+                if (op == 'D' && q == lineEnd) {
+                    command = batchCommand('D', buildType, 0, line);
+                } else if (op == 'C') {
+                    long long index;
+                    from_chars_result res = from_chars(q, lineEnd, index);
+                    if (res.ec == errc() && SkipBlanks(res.ptr, lineEnd) == lineEnd) {
+                        command = batchCommand('C', buildType, index, line);
+                    }
+                }
+            }
+            commands.push_back(command);
+        }
+
+        p = lineEnd + 1;
+    }
+}
+
+
+
+
+/* @brief Appends "Line N: message" to the batch report.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void ReportFailure(string& report, const batchCommand& command, const string& message) {
+
+    report += "Line ";
+    report += to_string(command.line);
+    report += ": ";
+    report += message;
+    report += '\n';
+}
+
+
+
+
+/* @brief Applies a list of commands to the colony without any prompting, as if they had been entered one by one in the menu.
+ *
+ * @param "commands" [in] Commands parsed by BatchParse.
+ *
+ * @param "head" [in][out] Reference to the head pointer of the colony DLL.
+ *
+ * @param "tail" [in][out] Reference to the tail pointer of the colony DLL.
+ *
+ * @param "stockHead" [in][out] Pointer to the head of the stock DLL, updated once at the end.
+ *
+ * @param "table" [in] Recipe table of the consumption DLL.
+ *
+ * @param "index" [in][out] Positional index of the colony, built beforehand and kept up to date.
+ *
+ * @param "stats" [out] Counts of the applied and failed commands.
+ *
+ * @param "report" [out] One "Line N: ..." line per failed command.
+ *
+ * @post The stock is worked on as a ledger (ledger.h). A run of consecutive constructs of the same type is checked as a
+ *       group: the number of affordable copies is found with one division per resource and deducted in one step, the
+ *       rest of the run fails with the same shortfall a one by one replay would report. A failed command changes nothing.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void RunBatch(const vector<batchCommand>& commands, colonyNode*& head, colonyNode*& tail, stockNode* stockHead, const consumpTable& table, colonyIndex& index, batchStats& stats, string& report) {
+
+    stockLedger ledger;
+    recipeMatrix matrix;
+    LedgerFromStock(stockHead, ledger);
+    RecipeMatrixBuild(table, ledger, matrix);
+
+    stats.commands += commands.size();
+
+    size_t i = 0;
+    while (i < commands.size()) {
+
+        const batchCommand& command = commands[i];
+        const long long* recipe = RecipeRow(matrix, command.buildType);
+
+        if (command.op == 'D') {
+
+            colonyNode* node = ColonyIndexFindFirst(index, command.buildType);
+
+            if (node == NULL) {
+                ReportFailure(report, command, string("Building of type ") + command.buildType + " not found in the colony.");
+                stats.failed++;
+            } else {
+                if (recipe != NULL) LedgerRefund(ledger, recipe);
+                ColonyRemoveBuilding(head, tail, node, &index);
+                stats.destroyed++;
+            }
+            i++;
+
+        } else if (command.op == 'C') {
+
+            // The run of constructs of this type
+            size_t runEnd = i;
+            long long placeable = 0;
+            while (runEnd < commands.size() && commands[runEnd].op == 'C' && commands[runEnd].buildType == command.buildType) {
+                if (commands[runEnd].index >= 1 && commands[runEnd].index <= INT_MAX) placeable++;
+                runEnd++;
+            }
+
+            long long granted = 0;
+            string shortage;
+
+            if (recipe != NULL) {
+                granted = LedgerAffordableTimes(ledger, recipe, placeable);
+                LedgerDeduct(ledger, recipe, granted);
+
+                if (granted < placeable) {
+                    shortage = "Insufficient resource " + ledger.names[LedgerFirstShortfall(ledger, recipe)];
+                }
+            }
+
+            for (; i < runEnd; i++) {
+
+                const batchCommand& construct = commands[i];
+
+                if (recipe == NULL) {
+                    ReportFailure(report, construct, string("Building type ") + construct.buildType + " is not found in the consumption DLL.");
+                    stats.failed++;
+                } else if (construct.index < 1 || construct.index > INT_MAX) {
+                    ReportFailure(report, construct, "Invalid empty block number " + to_string(construct.index));
+                    stats.failed++;
+                } else if (granted == 0) {
+                    ReportFailure(report, construct, shortage);
+                    stats.failed++;
+                } else {
+                    ColonyInsertAtEmptyBlock(head, tail, construct.buildType, (int)construct.index, &index);
+                    granted--;
+                    stats.constructed++;
+                }
+            }
+
+        } else {
+            ReportFailure(report, command, "Unable to parse the command.");
+            stats.failed++;
+            i++;
+        }
+    }
+
+    LedgerToStock(ledger, stockHead);
+}
@@ -0,0 +1,44 @@
+// Non-interactive batch mode, replays a file of construct / destroy commands
+
+#ifndef _BATCH_
+#define _BATCH_
+
+#include <string>
+#include <vector>
+#include "functions.h"
+#include "colonyindex.h"
+
+using namespace std;
+
+// Struct definitions
+//------------------------------------------------------------------------------------------
+// One line of a command file:  "C <buildType> <empty block number>"  or  "D <buildType>"
+// Blank lines and lines starting with '#' are skipped.
+struct batchCommand{
+
+    char op;            // 'C', 'D', or '?' for a line that could not be parsed
+    char buildType;
+    long long index;    // empty block number of a construct
+    long long line;     // 1-based line number in the command file, for the report
+
+    batchCommand(char o = '?', char c = '\0', long long i = 0, long long l = 0) :
+    op(o), buildType(c), index(i), line(l) {}
+};
+
+struct batchStats{
+
+    long long commands;
+    long long constructed;
+    long long destroyed;
+    long long failed;
+
+    batchStats() : commands(0), constructed(0), destroyed(0), failed(0) {}
+};
+//------------------------------------------------------------------------------------------
+//
+// Function prototypes
+//------------------------------------------------------------------------------------------
+void BatchParse(const char* p, const char* end, vector<batchCommand>& commands);
+void RunBatch(const vector<batchCommand>& commands, colonyNode*& head, colonyNode*& tail, stockNode* stockHead, const consumpTable& table, colonyIndex& index, batchStats& stats, string& report);
+//------------------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,928 @@
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <new>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+#include "functions.h"
+#include "colony.h"
+#include "colonyindex.h"
+#include "colonyview.h"
+#include "journal.h"
+#include "batch.h"
+#include "ledger.h"
+#include "mapped.h"
+#include "render.h"
+#include "snapshot.h"
+
+#ifdef COLONY_SERVER
+#include "mpscring.h"
+#include "server.h"
+#endif
+
+using namespace std;
+
+// Benchmarks for the colony hot paths, run the colony_bench target (Release build)
+//
+// usage: colony_bench [--buildings N] [--resources R] [--types T] [--ops K] [--gap G] [--threads P] [--scaling] [--stress]
+//   --buildings  buildings in the synthetic colony file (default 1000000)
+//   --resources  stock resources / recipe length (default 8)
+//   --types      building types with a recipe (default 26)
+//   --ops        operations for the per operation cases (default 1000)
+//   --gap        largest run of empty blocks between two buildings (default 8)
+//   --threads    threads of ColonyLoaderParallel (default 0, one per hardware thread)
+//   --scaling    also run PrintColonyReverse at 10K..10M buildings
+//   --stress     only run the reader/writer test of the views (100 * K changes, P readers, default 4), exits with 1
+//                if a reader saw a bad view (ctest runs it, see CMakeLists.txt)
+
+// Allocation counter, every global operator new of the process goes through here (from any thread, hence atomic)
+//------------------------------------------------------------------------------------------
+static atomic<long long> allocationCount(0);
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == NULL) throw bad_alloc();
+    return ptr;
+}
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+//------------------------------------------------------------------------------------------
+
+// Swallows everything written to cout while a printer is being timed
+struct nullBuffer : streambuf {
+    int overflow(int c) { return c; }
+    streamsize xsputn(const char*, streamsize n) { return n; }
+};
+
+struct benchConfig{
+
+    long long buildings;
+    int resources;
+    int types;
+    int ops;
+    int gap;
+    int threads;
+    bool scaling;
+    bool stress;
+
+    benchConfig() : buildings(1000000), resources(8), types(26), ops(1000), gap(8), threads(0), scaling(false), stress(false) {}
+};
+
+// Everything a case needs: the generated files and a loaded colony
+struct benchData{
+
+    string stockFile;
+    string consumptionFile;
+    string colonyFile;
+
+    stockNode* stockHead;
+    stockNode* stockTail;
+    consumpNode* consumpHead;
+    consumpNode* consumpTail;
+    consumpTable table;
+    colonyNode* colonyHead;
+    colonyNode* colonyTail;
+
+    benchData() : stockHead(NULL), stockTail(NULL), consumpHead(NULL), consumpTail(NULL), colonyHead(NULL), colonyTail(NULL) {}
+};
+
+static char TypeChar(int i) {
+    return i < 26 ? 'A' + i : 'a' + (i - 26) % 26;
+}
+
+// 0 where getrusage is not available (MinGW)
+static long long PeakRssKB() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // KB on Linux
+#else
+    return 0;
+#endif
+}
+
+/* @brief Times "ops" repetitions of work (one call does all of them) and prints ns/op, allocations and peak RSS.
+ *
+ * @param "setup" [in] Untimed preparation, run right before work.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void RunCase(const string& name, long long ops, function<void()> work, function<void()> setup = NULL) {
+
+    if (setup) setup();
+
+    nullBuffer sink;
+    streambuf* original = cout.rdbuf(&sink);
+
+    long long allocationsBefore = allocationCount.load(memory_order_relaxed);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    work();
+
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    long long allocations = allocationCount.load(memory_order_relaxed) - allocationsBefore;
+
+    cout.rdbuf(original);
+
+    printf("  %-40s %12lld ops %14.1f ns/op %12lld allocs %10.1f MB peak RSS\n",
+           name.c_str(), ops, ns / (ops > 0 ? ops : 1), allocations, PeakRssKB() / 1024.0);
+}
+
+/* @brief Writes the synthetic stock, consumption and colony files into a scratch directory.
+ *
+ * @post Every recipe costs 0..3 of each resource and the stock is big enough for the whole colony, so ColonyLoader never fails.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void GenerateDataset(const benchConfig& config, benchData& data) {
+
+    filesystem::path dir = filesystem::temp_directory_path() / "colony_bench";
+    filesystem::create_directories(dir);
+
+    data.stockFile = (dir / "stock.txt").string();
+    data.consumptionFile = (dir / "consumption.txt").string();
+    data.colonyFile = (dir / "colony.txt").string();
+
+    srand(12345);
+
+    vector<vector<int> > recipes(config.types, vector<int>(config.resources));
+    {
+        ofstream out(data.consumptionFile.c_str());
+        for (int t = 0; t < config.types; t++) {
+            out << TypeChar(t);
+            for (int r = 0; r < config.resources; r++) {
+                recipes[t][r] = rand() % 4;
+                out << " " << recipes[t][r];
+            }
+            out << "\n";
+        }
+    }
+
+    vector<long long> demand(config.resources, 0);
+    {
+        ofstream out(data.colonyFile.c_str(), ios::binary);
+        string chunk;
+        for (long long i = 0; i < config.buildings; i++) {
+            int t = rand() % config.types;
+            chunk.append(rand() % (config.gap + 1), '-');
+            chunk += TypeChar(t);
+            for (int r = 0; r < config.resources; r++) demand[r] += recipes[t][r];
+
+            if (chunk.size() > (1 << 20)) {
+                out.write(chunk.data(), chunk.size());
+                chunk.clear();
+            }
+        }
+        out.write(chunk.data(), chunk.size());
+    }
+
+    {
+        ofstream out(data.stockFile.c_str());
+        for (int r = 0; r < config.resources; r++) {
+            out << "Resource" << r << " " << demand[r] + 1000000 << "\n";
+        }
+    }
+}
+
+/* @brief Frees every DLL of a benchData.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void FreeData(benchData& data) {
+
+    DeleteAll(data.stockHead);
+    DeleteAll(data.consumpHead);
+    DeleteAll(data.colonyHead);
+
+    data.stockTail = NULL;
+    data.consumpTail = NULL;
+    data.colonyTail = NULL;
+    data.table = consumpTable();
+}
+
+/* @brief Loads the generated dataset with the iostream loaders (untimed helper for the mutation and printer cases).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void LoadData(benchData& data) {
+
+    FreeData(data);
+
+    ifstream stock(data.stockFile.c_str()), consumption(data.consumptionFile.c_str()), colony(data.colonyFile.c_str(), ios::binary);
+    StockLoader(stock, data.stockHead, data.stockTail);
+    ConsumptionLoader(consumption, data.consumpHead, data.consumpTail, data.table);
+    ColonyLoader(data.colonyHead, data.colonyTail, data.stockHead, data.table, colony);
+}
+
+static void BenchLoaders(const benchConfig& config, benchData& data) {
+
+    cout << "Loaders" << endl;
+
+    long long colonyBytes = filesystem::file_size(data.colonyFile);
+
+    RunCase("StockLoader", config.resources, [&]() {
+        ifstream file(data.stockFile.c_str());
+        StockLoader(file, data.stockHead, data.stockTail);
+    }, [&]() { FreeData(data); });
+
+    RunCase("ConsumptionLoader", config.types, [&]() {
+        ifstream file(data.consumptionFile.c_str());
+        ConsumptionLoader(file, data.consumpHead, data.consumpTail, data.table);
+    });
+
+    colonyLoadStats stats;
+    RunCase("ColonyLoader (per building)", config.buildings, [&]() {
+        ifstream colony(data.colonyFile.c_str(), ios::binary);
+        ColonyLoader(data.colonyHead, data.colonyTail, data.stockHead, data.table, colony, &stats);
+    });
+    printf("  %-40s %12lld bytes %13.1f MB/s\n", "ColonyLoader throughput", colonyBytes, stats.bytes / 1e6 / stats.seconds);
+
+    RunCase("StockLoaderMapped", config.resources, [&]() {
+        mappedFile file;
+        MapFile(data.stockFile, file);
+        StockLoaderMapped(file, data.stockHead, data.stockTail);
+        UnmapFile(file);
+    }, [&]() { FreeData(data); });
+
+    RunCase("ConsumptionLoaderMapped", config.types, [&]() {
+        mappedFile file;
+        MapFile(data.consumptionFile, file);
+        ConsumptionLoaderMapped(file, data.consumpHead, data.consumpTail, data.table);
+        UnmapFile(file);
+    });
+
+    RunCase("ColonyLoaderMapped (per building)", config.buildings, [&]() {
+        mappedFile file;
+        MapFile(data.colonyFile, file);
+        ColonyLoaderMapped(data.colonyHead, data.colonyTail, data.stockHead, data.table, file, &stats);
+        UnmapFile(file);
+    });
+    printf("  %-40s %12lld bytes %13.1f MB/s\n", "ColonyLoaderMapped throughput", colonyBytes, stats.bytes / 1e6 / stats.seconds);
+
+    RunCase("ColonyLoaderParallel (per building)", config.buildings, [&]() {
+        mappedFile file;
+        MapFile(data.colonyFile, file);
+        ColonyLoaderParallel(data.colonyHead, data.colonyTail, data.stockHead, data.table, file, config.threads, &stats);
+        UnmapFile(file);
+    }, [&]() {
+        FreeData(data);
+        ifstream stock(data.stockFile.c_str()), consumption(data.consumptionFile.c_str());
+        StockLoader(stock, data.stockHead, data.stockTail);
+        ConsumptionLoader(consumption, data.consumpHead, data.consumpTail, data.table);
+    });
+    printf("  %-40s %12d threads %11.1f MB/s\n", "ColonyLoaderParallel throughput", config.threads > 0 ? config.threads : (int)thread::hardware_concurrency(), stats.bytes / 1e6 / stats.seconds);
+
+    // Restart from a snapshot instead of the three text files
+    colonyState saved, loaded;
+    ColonyStateLoad(saved, data.stockFile, data.consumptionFile, data.colonyFile);
+    string snapshotFile = data.colonyFile + ".snap";
+
+    RunCase("ColonySnapshotSave (per building)", config.buildings, [&]() { ColonySnapshotSave(saved, snapshotFile); });
+    printf("  %-40s %12lld bytes\n", "snapshot size", (long long)filesystem::file_size(snapshotFile));
+
+    RunCase("ColonySnapshotLoad (per building)", config.buildings, [&]() { ColonySnapshotLoad(loaded, snapshotFile); });
+
+    // Restart from text files written by ColonyStateSaveTrusted, no per building checks
+    string trustedStock = data.stockFile + ".trusted", trustedColony = data.colonyFile + ".trusted";
+    ColonyStateSaveTrusted(saved, trustedStock, trustedColony);
+
+    RunCase("ColonyStateLoad (per building)", config.buildings, [&]() {
+        ColonyStateLoad(loaded, data.stockFile, data.consumptionFile, data.colonyFile);
+    }, [&]() { ColonyStateFree(loaded); });
+
+    RunCase("ColonyStateLoad (trusted, per building)", config.buildings, [&]() {
+        ColonyStateLoad(loaded, trustedStock, data.consumptionFile, trustedColony);
+    }, [&]() { ColonyStateFree(loaded); });
+
+    ColonyStateFree(loaded);
+    ColonyStateFree(saved);
+    filesystem::remove(snapshotFile);
+    filesystem::remove(trustedStock);
+    filesystem::remove(trustedColony);
+}
+
+static void BenchMutations(const benchConfig& config, benchData& data) {
+
+    cout << "Mutations" << endl;
+
+    LoadData(data);
+
+    vector<int> positions;
+    for (int i = 0; i < config.ops; i++) {
+        positions.push_back(1 + (long long)rand() % (config.buildings * config.gap / 2 + 1));
+    }
+
+    stockNode* shortNode = NULL;
+    RunCase("ConstructBuilding", config.ops, [&]() {
+        for (int i = 0; i < config.ops; i++) {
+            ConstructBuilding(data.colonyHead, data.colonyTail, data.table, data.stockHead, TypeChar(i % config.types), positions[i], shortNode);
+        }
+    });
+
+    colonyIndex index;
+    RunCase("ColonyIndexBuild (per building)", config.buildings, [&]() {
+        ColonyIndexBuild(data.colonyHead, index);
+    });
+
+    RunCase("ConstructBuilding (indexed)", config.ops, [&]() {
+        for (int i = 0; i < config.ops; i++) {
+            ConstructBuilding(data.colonyHead, data.colonyTail, data.table, data.stockHead, TypeChar(i % config.types), positions[i], shortNode, &index);
+        }
+    });
+
+    RunCase("DestroyBuilding", config.ops, [&]() {
+        for (int i = 0; i < config.ops; i++) {
+            DestroyBuilding(data.colonyHead, data.colonyTail, TypeChar(i % config.types), data.table, data.stockHead, &index);
+        }
+    });
+
+    RunCase("DestroyBuilding (rare type)", config.ops, [&]() {
+        for (int i = 0; i < config.ops; i++) {
+            DestroyBuilding(data.colonyHead, data.colonyTail, '#', data.table, data.stockHead, &index);
+        }
+    });
+
+    RunCase("ConstructBuilding + DestroyBuilding", config.ops, [&]() {
+        for (int i = 0; i < config.ops; i++) {
+            char type = TypeChar(i % config.types);
+            if (ConstructBuilding(data.colonyHead, data.colonyTail, data.table, data.stockHead, type, 1 + i, shortNode, &index) == COLONY_OK) {
+                DestroyBuilding(data.colonyHead, data.colonyTail, type, data.table, data.stockHead, &index);
+            }
+        }
+    });
+
+    // The same kind of mix as a command file: runs of 8 same type constructs followed by 4 deletes
+    vector<batchCommand> commands;
+    for (int i = 0; (int)commands.size() < config.ops; i++) {
+        char type = TypeChar(i % config.types);
+        for (int k = 0; k < 8; k++) commands.push_back(batchCommand('C', type, 1 + (long long)rand() % (config.buildings * config.gap / 2 + 1), 0));
+        for (int k = 0; k < 4; k++) commands.push_back(batchCommand('D', TypeChar((i + k) % config.types), 0, 0));
+    }
+    RunCase("RunBatch (per command)", commands.size(), [&]() {
+        batchStats stats;
+        string report;
+        RunBatch(commands, data.colonyHead, data.colonyTail, data.stockHead, data.table, index, stats, report);
+    });
+
+    string decoded;
+    RunCase("decodeColony (per building)", config.buildings, [&]() {
+        decoded = decodeColony(data.colonyHead);
+    });
+
+    colonyNode* encoded = NULL;
+    RunCase("encodeColony (per building)", config.buildings, [&]() {
+        encoded = encodeColony(decoded);
+    });
+    DeleteAll(encoded);
+
+    // Many buildings of one type: one by one against one affordability computation and one pass
+    colonyState state;
+    ColonyStateLoad(state, data.stockFile, data.consumptionFile, data.colonyFile);
+    long long bulk = (long long)config.ops * 100, built = 0;
+
+    RunCase("ColonyConstruct (first block)", config.ops, [&]() {
+        for (int i = 0; i < config.ops; i++) {
+            ColonyConstruct(state, TypeChar(0), 1);
+        }
+    });
+
+    RunCase("ColonyConstructFirstFit (per building)", bulk, [&]() {
+        ColonyConstructFirstFit(state, TypeChar(0), bulk, built);
+    });
+
+    // Many buildings removed: one by one against one pass and one refund
+    RunCase("ColonyDestroy (first of a type)", config.ops, [&]() {
+        for (int i = 0; i < config.ops; i++) {
+            ColonyDestroy(state, TypeChar(1 % config.types));
+        }
+    });
+
+    long long destroyed = 0;
+    RunCase("ColonyDestroyMany (per building)", state.index.typeCount[(unsigned char)TypeChar(1 % config.types)], [&]() {
+        ColonyDestroyMany(state, TypeChar(1 % config.types), LLONG_MAX, destroyed);
+    });
+
+    // The left half of the colony
+    long long half = (ColonyIndexTotalEmptyBlocks(state.index) + state.index.root->nodeCount) / 2, inRange = 0, block = 0;
+    for (colonyNode* ptr = state.colonyHead; ptr != NULL && (block += ptr->emptyBlocks2TheLeft + 1) < half; ptr = ptr->next) inRange++;
+
+    RunCase("ColonyDestroyRange (per building)", inRange, [&]() {
+        ColonyDestroyRange(state, 1, half, destroyed);
+    });
+
+    ColonyStateFree(state);
+}
+
+static void BenchJournal(const benchConfig& config, benchData& data) {
+
+    cout << "Journal" << endl;
+
+    colonyState state;
+    ColonyStateLoad(state, data.stockFile, data.consumptionFile, data.colonyFile);
+    string journalFile = data.colonyFile + ".journal";
+    filesystem::remove(journalFile);
+
+    // Durable without a journal: write the whole colony out after a change
+    string trustedStock = data.stockFile + ".trusted", trustedColony = data.colonyFile + ".trusted";
+    int saves = max(1, config.ops / 100);
+    RunCase("ColonyStateSaveTrusted (per save)", saves, [&]() {
+        for (int i = 0; i < saves; i++) {
+            ColonyStateSaveTrusted(state, trustedStock, trustedColony);
+        }
+    });
+
+    // The same files again after one construct each: only the changed blocks of the colony file are rewritten
+    RunCase("ColonyStateSaveTrusted (patch, per save)", saves, [&]() {
+        for (int i = 0; i < saves; i++) {
+            ColonyConstruct(state, TypeChar(i % config.types), 1 + i * 1000);
+            ColonyStateSaveTrusted(state, trustedStock, trustedColony);
+        }
+    });
+
+    colonyJournal journal;
+    long long replayed = 0;
+
+    JournalOpen(journal, journalFile, state, 0, replayed);
+    RunCase("ColonyConstruct + JournalAppend (sync each)", config.ops, [&]() {
+        for (int i = 0; i < config.ops; i++) {
+            char type = TypeChar(i % config.types);
+            if (ColonyConstruct(state, type, 1 + i).result == COLONY_OK) JournalAppend(journal, JOURNAL_CONSTRUCT, type, 1 + i);
+        }
+    });
+    JournalClose(journal);
+
+    // Group commit on top of the input files, replayed afterwards
+    long long grouped = (long long)config.ops * 10;
+    filesystem::remove(journalFile);
+    ColonyStateFree(state);
+    ColonyStateLoad(state, data.stockFile, data.consumptionFile, data.colonyFile);
+
+    JournalOpen(journal, journalFile, state, 1000, replayed);
+    RunCase("ColonyConstruct + JournalAppend (1 ms group)", grouped, [&]() {
+        for (long long i = 0; i < grouped; i++) {
+            char type = TypeChar(i % config.types);
+            if (ColonyConstruct(state, type, 1 + (int)i).result == COLONY_OK) JournalAppend(journal, JOURNAL_CONSTRUCT, type, 1 + i);
+        }
+        JournalSync(journal);
+    });
+    long long records = journal.records;
+    JournalClose(journal);
+
+    RunCase("JournalOpen (replay, per record)", records, [&]() {
+        JournalOpen(journal, journalFile, state, 0, replayed);
+    }, [&]() {
+        ColonyStateFree(state);
+        ColonyStateLoad(state, data.stockFile, data.consumptionFile, data.colonyFile);
+    });
+    JournalClose(journal);
+
+    ColonyStateFree(state);
+    filesystem::remove(journalFile);
+    filesystem::remove(trustedStock);
+    filesystem::remove(trustedColony);
+}
+
+/* @brief The recipe of every building type of a state, indexed by the type.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static vector<vector<int> > RecipesOf(const colonyState& state) {
+
+    vector<vector<int> > recipes(256);
+    for (consumpNode* ptr = state.consumpHead; ptr != NULL; ptr = ptr->next) recipes[(unsigned char)ptr->buildType] = ptr->consumpQtys;
+    return recipes;
+}
+
+/* @brief What a view adds up to per resource: its stock plus what its buildings cost. Construction and destruction
+ *        move resources between the two, so every whole version of a colony adds up to the same amounts.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static vector<long long> ViewResources(const colonyView& view, const vector<vector<int> >& recipes) {
+
+    long long counts[256] = {0};
+    for (const shared_ptr<const colonyViewChunk>& chunk : view.chunks) {
+        if (chunk == NULL) continue;
+        for (const colonyRun& run : chunk->runs) counts[(unsigned char)run.buildType]++;
+    }
+
+    vector<long long> total(view.stock.size());
+    for (size_t r = 0; r < total.size(); r++) {
+        total[r] = view.stock[r].second;
+        for (int c = 0; c < 256; c++) {
+            if (r < recipes[c].size()) total[r] += counts[c] * recipes[c][r];
+        }
+    }
+    return total;
+}
+
+/* @brief Readers on several threads take published views of a colony while one writer keeps constructing and
+ *        destroying and publishing after each pair. Every view a reader gets must be a whole version: the stock plus what
+ *        its buildings cost adds up to the resources the colony started with, and versions never go backwards.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void BenchViews(const benchConfig& config, benchData& data) {
+
+    cout << "Published views (10000 buildings)" << endl;
+
+    string viewColony = data.colonyFile + ".view";
+    {
+        ofstream out(viewColony.c_str(), ios::binary);
+        for (int i = 0; i < 10000; i++) out << '-' << TypeChar(i % config.types);
+    }
+
+    colonyState state;
+    ColonyStateLoad(state, data.stockFile, data.consumptionFile, viewColony);
+
+    colonyPublisher publisher;
+    RunCase("ColonyPublish", config.ops, [&]() {
+        for (int i = 0; i < config.ops; i++) ColonyPublish(state, publisher);
+    });
+
+    // A change between two publications, only the chunk it touched is rebuilt
+    RunCase("ColonyConstruct+ColonyDestroy+ColonyPublish", config.ops, [&]() {
+        for (int i = 0; i < config.ops; i++) {
+            char type = TypeChar(i % config.types);
+            ColonyConstruct(state, type, 1 + i % 5000);
+            ColonyDestroy(state, type);
+            ColonyPublish(state, publisher);
+        }
+    });
+
+    vector<vector<int> > recipes = RecipesOf(state);
+    auto Resources = [&](const colonyView& view) { return ViewResources(view, recipes); };
+    vector<long long> expected = Resources(*ColonyViewAcquire(publisher));
+
+    for (int readers : {1, 4}) {
+
+        long long reads = (long long)config.ops * 10;
+        atomic<bool> done(false);
+        atomic<long long> inconsistent(0);
+        long long mutations = 0;
+
+        RunCase("ColonyViewAcquire+check x" + to_string(readers) + " + writer", reads * readers, [&]() {
+
+            thread writer([&]() {
+                for (long long i = 0; !done; i++) {
+                    char type = TypeChar(i % config.types);
+                    if (ColonyConstruct(state, type, 1 + i % 5000).result == COLONY_OK) mutations++;
+                    if (ColonyDestroy(state, type).result == COLONY_OK) mutations++;
+                    ColonyPublish(state, publisher);
+                }
+            });
+
+            vector<thread> threads;
+            for (int t = 0; t < readers; t++) {
+                threads.push_back(thread([&]() {
+                    long long version = 0;
+                    for (long long i = 0; i < reads; i++) {
+                        shared_ptr<const colonyView> view = ColonyViewAcquire(publisher);
+                        if (view->version < version || Resources(*view) != expected) inconsistent++;
+                        version = view->version;
+                    }
+                }));
+            }
+            for (thread& t : threads) t.join();
+
+            done = true;
+            writer.join();
+        });
+
+        printf("    writer: %lld mutations, %lld inconsistent views\n", mutations, inconsistent.load());
+    }
+
+    ColonyStateFree(state);
+    filesystem::remove(viewColony);
+}
+
+/* @brief Stress test of the published views (--stress): readers on several threads take views of the generated
+ *        colony while one writer constructs, destroys, fills gaps and clears block ranges, publishing after runs of one
+ *        to three changes. Clearing ranges shrinks and regrows the colony, so chunks are added and dropped as well.
+ *
+ * @return The number of bad views: one that does not add up to the resources of the first view (ViewResources), does
+ *         not render to exactly its length, or has a lower version than a view the same reader took before.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static long long StressViews(const benchConfig& config, benchData& data) {
+
+    colonyState state;
+    if (ColonyStateLoad(state, data.stockFile, data.consumptionFile, data.colonyFile).result != COLONY_OK) return 1;
+
+    colonyPublisher publisher;
+    ColonyPublish(state, publisher);
+
+    vector<vector<int> > recipes = RecipesOf(state);
+    vector<long long> expected = ViewResources(*ColonyViewAcquire(publisher), recipes);
+
+    int readers = config.threads > 0 ? config.threads : 4;
+    long long steps = (long long)config.ops * 100;
+    atomic<bool> done(false);
+    atomic<long long> bad(0), reads(0);
+
+    thread writer([&]() {
+        int pending = 0;
+        for (long long i = 0; i < steps; i++) {
+            char type = TypeChar(i % config.types);
+            long long count = 0;
+
+            switch (i % 4) {
+                case 0: ColonyConstruct(state, type, 1 + (int)(i * 7919 % (config.buildings + 1))); break;
+                case 1: ColonyDestroy(state, type); break;
+                case 2: ColonyConstructFirstFit(state, type, 1 + i % 5, count); break;
+                case 3: {
+                    long long blocks = ColonyViewAcquire(publisher)->blocks;
+                    // Every eighth one clears the end of the colony, so whole chunks go and come back
+                    if ((i / 4) % 8 == 0) ColonyDestroyRange(state, max(1LL, blocks - 4 * COLONY_VIEW_CHUNK), blocks + 1, count);
+                    else {
+                        long long first = 1 + i * 104729 % (blocks + 1);
+                        ColonyDestroyRange(state, first, first + 1 + i % 64, count);
+                    }
+                    break;
+                }
+            }
+            if (++pending > (i / 4) % 3) {
+                ColonyPublish(state, publisher);
+                pending = 0;
+            }
+        }
+        ColonyPublish(state, publisher);
+        done = true;
+    });
+
+    vector<thread> threads;
+    for (int t = 0; t < readers; t++) {
+        threads.push_back(thread([&]() {
+            long long version = 0;
+            string buffer;
+            while (!done) {
+                shared_ptr<const colonyView> view = ColonyViewAcquire(publisher);
+
+                buffer.assign(ViewColonyLength(*view), '\0');
+                bool whole = RenderViewColony(*view, &buffer[0]) == buffer.data() + buffer.size();
+
+                if (view->version < version || !whole || ViewResources(*view, recipes) != expected) bad++;
+                version = view->version;
+                reads++;
+            }
+        }));
+    }
+
+    writer.join();
+    for (thread& t : threads) t.join();
+
+    // The final view has to match the colony itself
+    shared_ptr<const colonyView> last = ColonyViewAcquire(publisher);
+    string rendered(ViewColonyLength(*last), '\0');
+    RenderViewColony(*last, &rendered[0]);
+    string colony(DecodedColonyLength(state.colonyHead), '\0');
+    RenderDecodedColony(state.colonyHead, &colony[0]);
+    if (rendered != colony) bad++;
+
+    cout << "views stress: " << steps << " changes, " << last->version << " versions, " << reads.load() << " reads by "
+         << readers << " readers, " << bad.load() << " bad views" << endl;
+
+    ColonyStateFree(state);
+    return bad.load();
+}
+
+#ifdef COLONY_SERVER
+static void BenchServer(const benchConfig& config, benchData& data) {
+
+    cout << "Server (" << SERVER_DEFAULT_WORKERS << " workers)" << endl;
+
+    // Many small colonies of 1000 buildings each, the case the server is for
+    string smallColony = data.colonyFile + ".small";
+    {
+        ofstream out(smallColony.c_str(), ios::binary);
+        for (int i = 0; i < 1000; i++) out << '-' << TypeChar(i % config.types);
+    }
+
+    colonyServer server;
+    ServerStart(server, SERVER_DEFAULT_WORKERS);
+
+    int colonies = 256;
+    RunCase("ServerExecute LOAD (per colony)", colonies, [&]() {
+        for (int i = 0; i < colonies; i++) {
+            ServerExecute(server, "LOAD c" + to_string(i) + " " + data.stockFile + " " + data.consumptionFile + " " + smallColony);
+        }
+    });
+
+    // Every client works on colonies of its own, a construct and a destroy per step
+    for (int clients : {1, SERVER_DEFAULT_WORKERS}) {
+
+        long long steps = (long long)config.ops * 10;
+        RunCase("ServerExecute CONSTRUCT+DESTROY x" + to_string(clients), steps * 2, [&]() {
+            vector<thread> threads;
+            for (int c = 0; c < clients; c++) {
+                threads.push_back(thread([&, c]() {
+                    for (long long i = c; i < steps; i += clients) {
+                        string colony = " c" + to_string(i % colonies) + " ";
+                        char type = TypeChar(i % config.types);
+                        ServerExecute(server, "CONSTRUCT" + colony + type + " " + to_string(1 + i % 500));
+                        ServerExecute(server, "DESTROY" + colony + type);
+                    }
+                }));
+            }
+            for (thread& t : threads) t.join();
+        });
+    }
+
+    RunCase("ServerExecute COLONY (per colony)", colonies, [&]() {
+        for (int i = 0; i < colonies; i++) {
+            ServerExecute(server, "COLONY c" + to_string(i));
+        }
+    });
+
+    ServerStop(server);
+
+    // The queue alone: producers push, one consumer drains in batches as a shard worker does
+    cout << "mpscRing (per value)" << endl;
+
+    for (int producers : {1, 4, 16, 64}) {
+
+        long long values = (long long)config.ops * 100;
+        mpscRing<long long> ring(SERVER_QUEUE_CAPACITY);
+
+        RunCase("push + popMany x" + to_string(producers) + " producers", values, [&]() {
+            vector<thread> threads;
+            for (int p = 0; p < producers; p++) {
+                threads.push_back(thread([&, p]() {
+                    for (long long i = p; i < values; i += producers) ring.push(i);
+                }));
+            }
+
+            long long drained = 0, batch[SERVER_BATCH_MAX];
+            while (drained < values) {
+                size_t taken = ring.popMany(batch, SERVER_BATCH_MAX);
+                if (taken == 0) ring.waitForWork();
+                drained += taken;
+            }
+            for (thread& t : threads) t.join();
+        });
+    }
+
+    // Submission throughput into a single mutator: one worker, every producer thread on a colony of its own
+    cout << "Server (1 worker, per command)" << endl;
+
+    for (int producers : {1, 2, 4, 8, 16, 32, 64}) {
+
+        colonyServer single;
+        ServerStart(single, 1);
+        for (int p = 0; p < producers; p++) {
+            ServerExecute(single, "LOAD p" + to_string(p) + " " + data.stockFile + " " + data.consumptionFile + " " + smallColony);
+        }
+
+        long long steps = (long long)config.ops * 10;
+        RunCase("CONSTRUCT+DESTROY x" + to_string(producers) + " producers", steps * 2, [&]() {
+            vector<thread> threads;
+            for (int p = 0; p < producers; p++) {
+                threads.push_back(thread([&, p]() {
+                    string colony = " p" + to_string(p) + " ";
+                    for (long long i = p; i < steps; i += producers) {
+                        char type = TypeChar(i % config.types);
+                        ServerExecute(single, "CONSTRUCT" + colony + type + " " + to_string(1 + i % 500));
+                        ServerExecute(single, "DESTROY" + colony + type);
+                    }
+                }));
+            }
+            for (thread& t : threads) t.join();
+        });
+
+        ServerStop(single);
+    }
+
+    filesystem::remove(smallColony);
+}
+#endif
+
+static void BenchPrinters(const benchConfig& config, benchData& data) {
+
+    cout << "Printers (per building)" << endl;
+
+    LoadData(data);
+
+    RunCase("PrintColony", config.buildings, [&]() { PrintColony(data.colonyHead); });
+    RunCase("PrintColonyReverse", config.buildings, [&]() { PrintColonyReverse(data.colonyTail); });
+    RunCase("PrintColonyWithInnerEmptyBlocks", config.buildings, [&]() { PrintColonyWithInnerEmptyBlocks(data.colonyHead); });
+    RunCase("PrintColonyWithInnerEmptyBlocksREVERSE", config.buildings, [&]() { PrintColonyWithInnerEmptyBlocksREVERSE(data.colonyHead); });
+    RunCase("PrintStock (per resource)", config.resources, [&]() { PrintStock(data.stockHead); });
+}
+
+static void BenchLedger(const benchConfig& config, benchData& data) {
+
+    cout << "Stock ledger (" << LedgerKernelName() << ")" << endl;
+
+    stockLedger ledger;
+    recipeMatrix matrix;
+    LedgerFromStock(data.stockHead, ledger);
+    RecipeMatrixBuild(data.table, ledger, matrix);
+
+    long long checks = (long long)config.ops * 1000;
+    long long affordable = 0;
+
+    RunCase("LedgerCanAfford", checks, [&]() {
+        for (long long i = 0; i < checks; i++) {
+            affordable += LedgerCanAfford(ledger, RecipeRow(matrix, TypeChar(i % config.types)));
+        }
+    });
+
+    RunCase("LedgerTryDeduct + LedgerRefund", checks, [&]() {
+        for (long long i = 0; i < checks; i++) {
+            const long long* row = RecipeRow(matrix, TypeChar(i % config.types));
+            if (LedgerTryDeduct(ledger, row)) LedgerRefund(ledger, row);
+        }
+    });
+
+    // Demand of the whole colony, answered from the type counts of the index (the view borrows the DLLs of data)
+    colonyState view;
+    view.stockHead = data.stockHead;
+    view.table = data.table;
+    ColonyIndexBuild(data.colonyHead, view.index);
+
+    vector<long long> totals;
+    RunCase("ColonyTotalConsumption", config.ops, [&]() {
+        for (int i = 0; i < config.ops; i++) {
+            ColonyTotalConsumption(view, totals);
+            affordable += totals[0];
+        }
+    });
+
+    if (affordable < 0) cout << affordable; // keeps the loop alive
+}
+
+static void BenchScaling() {
+
+    cout << "PrintColonyReverse scaling (ns/op has to stay flat)" << endl;
+
+    long long sizes[] = {10000, 100000, 1000000, 10000000};
+
+    for (long long n : sizes) {
+
+        colonyNode* head = NULL;
+        colonyNode* tail = NULL;
+        for (long long i = 0; i < n; i++) {
+            ColonyAddToEnd(head, tail, TypeChar(i % 10), (int)(i % 4));
+        }
+
+        RunCase("PrintColonyReverse @" + to_string(n), n, [&]() { PrintColonyReverse(tail); });
+
+        DeleteAll(head);
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    benchConfig config;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--buildings" && hasValue) config.buildings = atoll(argv[++i]);
+        else if (arg == "--resources" && hasValue) config.resources = atoi(argv[++i]);
+        else if (arg == "--types" && hasValue) config.types = atoi(argv[++i]);
+        else if (arg == "--ops" && hasValue) config.ops = atoi(argv[++i]);
+        else if (arg == "--gap" && hasValue) config.gap = atoi(argv[++i]);
+        else if (arg == "--threads" && hasValue) config.threads = atoi(argv[++i]);
+        else if (arg == "--scaling") config.scaling = true;
+        else if (arg == "--stress") config.stress = true;
+        else {
+            cout << "usage: colony_bench [--buildings N] [--resources R] [--types T] [--ops K] [--gap G] [--threads P] [--scaling] [--stress]" << endl;
+            return 1;
+        }
+    }
+
+    if (config.types < 1 || config.types > 52 || config.resources < 1 || config.buildings < 1 || config.ops < 0 || config.gap < 0) {
+        cout << "colony_bench: sizes out of range (1 <= types <= 52)" << endl;
+        return 1;
+    }
+
+    cout << "colony_bench: " << config.buildings << " buildings, " << config.resources << " resources, "
+         << config.types << " types, " << config.ops << " ops" << endl;
+
+    benchData data;
+    GenerateDataset(config, data);
+
+    // Pass/fail mode for ctest, see StressViews
+    if (config.stress) {
+        return StressViews(config, data) == 0 ? 0 : 1;
+    }
+
+    BenchLoaders(config, data);
+    BenchMutations(config, data);
+    BenchJournal(config, data);
+    BenchViews(config, data);
+    #ifdef COLONY_SERVER
+    BenchServer(config, data);
+    #endif
+    BenchPrinters(config, data);
+    BenchLedger(config, data);
+
+    if (config.scaling) {
+        BenchScaling();
+    }
+
+    FreeData(data);
+
+    printf("peak RSS %.1f MB\n", PeakRssKB() / 1024.0);
+
+    return 0;
+}
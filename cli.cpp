@@ -0,0 +1,495 @@
+#include "cli.h"
+#include "batch.h"
+#include "mapped.h"
+#include "render.h"
+#include "snapshot.h"
+
+#include <climits>
+#include <cstring>
+
+//#define DEBUG
+
+/* @brief Universal file openner with built-in prompting
+ *
+ * @param "file" [in][out] Ifstream object which the function will return
+ *
+ * @param "typeOfInput" [in] A string that will be used to decide the type of the txt file (stock/consumption/colony)
+ *
+ * @Precondition: An ifstream object is not bound to a file and the typeOfInput is determined beforehand
+ *
+ * @Postcondition: The ifstream object is bound to a file, if the file does not exist or fails to open,
+ *                 the user is prompted to enter the filename again until a valid file is provided.
+ *                 Returns the name of the file that has been opened (used by the memory mapped input mode).
+ *
+ * @note Debug code included
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+string fileOpenner(ifstream &file, string typeOfInput){
+
+    cout << "Please enter the " << typeOfInput <<" file name:" << endl;
+    string filename;
+    cin >> filename;
+    file.open(filename.c_str());
+
+    while( file.fail() ){
+        cout<< "Unable to open the file " << filename << ". ";
+        cout<< "Please enter the correct " << typeOfInput <<" file name:" << endl;
+        cin >> filename;
+        file.open(filename.c_str());
+    }
+
+    #ifdef DEBUG
+    cout << "DEBUG: " << typeOfInput << " FILE HAS BEEN SUCCESSFULLY OPENNED !" << endl;
+    #endif
+
+    return filename;
+}
+
+
+
+
+/* @brief Tells the user why the input files could not be loaded, in the words of the original loader.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void PrintLoadFailure(const colonyStatus& status) {
+
+    if (status.result == COLONY_OPEN_FAILED) {
+        cout << "Unable to open the file " << status.detail << "." << endl;
+        return;
+    }
+
+    if (status.result == COLONY_BAD_SNAPSHOT) {
+        cout << "The file " << status.detail << " is not a valid colony snapshot." << endl;
+        return;
+    }
+
+    if (status.result == COLONY_BAD_JOURNAL) {
+        cout << "The journal " << status.detail << " does not belong to the loaded colony." << endl;
+        return;
+    }
+
+    if (status.result == COLONY_INSUFFICIENT) {
+        cout << "Insufficient resource " << status.detail << endl;
+        cout << "Failed to load the colony due to insufficient resources." << endl;
+    } else {
+        cout << "Unknown building type " << status.buildType << endl;
+        cout << "Failed to load the colony due to an unknown building type." << endl;
+    }
+    cout << "Clearing the memory and terminating the program." << endl;
+}
+
+
+
+
+/* @brief Tells the user that a change could not be recorded in the journal (JournalAppend returned false).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void PrintJournalFailure(const colonyJournal& journal) {
+
+    cout << "The change could not be written to the journal " << journal.filename << ", changes are no longer journaled." << endl;
+}
+
+
+
+
+/* @brief Deletes a specified building type from the colony doubly linked list (DLL). If the building type is found,
+ *        it's first occurrance is removed from the colony DLL, and the resources associated with it are added back to the stock.
+ *        If the building type is not found, the user will be displayed with an appropriate message.
+ *
+ * @param "state" [in][out] The colony, its stock DLL is updated based on the resources associated with the deleted building.
+ *
+ * @param "buildingType" [in] The type of building to be deleted from the colony.
+ *
+ * @param "journal" [in][out] Optional journal, the change is recorded in it.
+ *
+ * @note represents button 2 in CLI menu
+ *
+ * @see ColonyDestroy
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void DeleteBuildingFromColony(colonyState& state, char buildingType, colonyJournal* journal) {
+
+    // If the node is not found in the DLL
+    if (ColonyDestroy(state, buildingType).result == COLONY_NOT_FOUND) {
+        cout << "Building of type " << buildingType << " not found in the colony." << endl;
+
+        //Clearing input buffer so that menu inputs wont interfere with last failed menu option case
+        cin.clear();
+        cin.ignore(9999999, '\n');
+        return; // return to asking menu options
+    }
+
+    if (journal != NULL && !JournalAppend(*journal, JOURNAL_DESTROY, buildingType)) PrintJournalFailure(*journal);
+
+    cout << "The building of type " << buildingType << " has been deleted from the colony." << endl;
+}
+
+
+
+
+/* @brief Constructs a new building in the colony based on the user's input for building type and its position with stock and memory management in mind.
+ *
+ * @param "state" [in][out] The colony, its stock and its positional index.
+ *
+ * @param "journal" [in][out] Optional journal, the change is recorded in it.
+ *
+ * @note Debug code included
+ *
+ * @note represents button 1 in CLI menu
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ConstructNewBuilding(colonyState& state, colonyJournal* journal) {
+
+    // First stage, ask for buildingType
+    char buildingType;
+    cout << "Please enter the building type:" << endl;
+    cin >> buildingType;
+
+
+    // Second stage, Validate the building type
+    consumpNode* consumpPtr = FindConsumption(state.table, buildingType);
+
+    while (consumpPtr == NULL) {
+
+        cout << "Building type " << buildingType << " is not found in the consumption DLL. Please enter a valid building type:" << endl;
+        cin >> buildingType;
+
+        consumpPtr = FindConsumption(state.table, buildingType);
+    }
+
+
+    // Third stage, Reserve the resources: check and deduct in a single walk over the stock, nothing is deducted if a resource is insufficient
+    stockNode* shortNode = NULL;
+    if (!ReserveResources(state.stockHead, consumpPtr->consumpQtys, shortNode)) {
+
+        cout << "Insufficient resource " << shortNode->resourceName << endl;
+        cout << "Failed to add the building due to insufficient resources." << endl;
+        return;
+    }
+
+
+    //Fourth stage, prompt the user for the index of the empty block and splice a single new node into the colony DLL in place.
+    int index;
+    cout << "Please enter the index of the empty block where you want to construct a building of type " << buildingType << endl;
+    cin >> index;
+
+    while (index < 1) {
+        cout << "Empty block numbers start from 1. Please enter a valid index:" << endl;
+        cin >> index;
+    }
+
+    ColonyPlaceReserved(state, buildingType, index);
+    if (journal != NULL && !JournalAppend(*journal, JOURNAL_CONSTRUCT, buildingType, index)) PrintJournalFailure(*journal);
+
+    cout << "Building of type " << buildingType << " has been added at the empty block number: " << index << endl;
+}
+
+
+
+
+/* @brief Prompts for a file name and saves the colony, its stock and the recipes into a binary snapshot.
+ *
+ * @param "state" [in] The colony to be saved.
+ *
+ * @note represents button 9 in CLI menu
+ *
+ * @see ColonySnapshotSave
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void SaveColonySnapshot(const colonyState& state) {
+
+    string filename;
+    cout << "Please enter the snapshot file name:" << endl;
+    cin >> filename;
+
+    colonyStatus status = ColonySnapshotSave(state, filename);
+
+    if (status.result != COLONY_OK) {
+        PrintLoadFailure(status);
+        return;
+    }
+
+    cout << "The colony has been saved to " << filename << "." << endl;
+}
+
+
+
+
+/* @brief Prompts for a file name and replaces the colony with the one in a binary snapshot.
+ *
+ * @param "state" [in][out] The colony, only replaced if the snapshot could be loaded.
+ *
+ * @param "journal" [in][out] Optional journal, started over on top of the loaded colony.
+ *
+ * @note represents button 10 in CLI menu
+ *
+ * @see ColonySnapshotLoad
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void LoadColonySnapshot(colonyState& state, colonyJournal* journal) {
+
+    string filename;
+    cout << "Please enter the snapshot file name:" << endl;
+    cin >> filename;
+
+    colonyState loaded;
+    colonyStatus status = ColonySnapshotLoad(loaded, filename);
+
+    if (status.result != COLONY_OK) {
+        PrintLoadFailure(status);
+        return;
+    }
+
+    ColonyStateFree(state);
+    state = loaded;
+
+    if (journal != NULL && JournalCheckpoint(*journal, state).result != COLONY_OK) {
+        cout << "Unable to open the file " << journal->filename << ", changes are no longer journaled." << endl;
+    }
+
+    cout << "The colony has been loaded from " << filename << "." << endl;
+}
+
+
+
+
+/* @brief Prompts for two file names and saves the stock and the colony as input files that load without re-checking
+ *        the resources of every building.
+ *
+ * @param "state" [in][out] The colony to be saved, it remembers the colony file so that the next save only patches it.
+ *
+ * @param "journal" [in][out] Optional journal, started over on top of the saved files.
+ *
+ * @note represents button 11 in CLI menu
+ *
+ * @see ColonyStateSaveTrusted
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void SaveTrustedFiles(colonyState& state, colonyJournal* journal) {
+
+    string stockFilename, colonyFilename;
+    cout << "Please enter the stock file name:" << endl;
+    cin >> stockFilename;
+    cout << "Please enter the colony file name:" << endl;
+    cin >> colonyFilename;
+
+    colonyStatus status = ColonyStateSaveTrusted(state, stockFilename, colonyFilename);
+
+    if (status.result != COLONY_OK) {
+        PrintLoadFailure(status);
+        return;
+    }
+
+    if (journal != NULL && JournalCheckpoint(*journal, state).result != COLONY_OK) {
+        cout << "Unable to open the file " << journal->filename << ", changes are no longer journaled." << endl;
+    }
+
+    cout << "The colony has been saved to " << stockFilename << " and " << colonyFilename << "." << endl;
+}
+
+
+
+
+/* @brief Prints what the colony as a whole consumes, one "name(total)" line per stock resource.
+ *
+ * @param "state" [in] The colony.
+ *
+ * @note represents button 12 in CLI menu
+ *
+ * @see ColonyTotalConsumption
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void PrintTotalConsumption(const colonyState& state) {
+
+    vector<long long> totals;
+    ColonyTotalConsumption(state, totals);
+
+    string buffer = "Total consumption:\n";
+
+    int i = 0;
+    for (stockNode* ptr = state.stockHead; ptr != NULL; ptr = ptr->next, i++) {
+        buffer += ptr->resourceName + "(" + to_string(totals[i]) + ")\n";
+    }
+
+    EmitBuffer(buffer);
+}
+
+
+
+
+/* @brief Constructs several buildings of one type on the first empty blocks of the colony, paying for them at once.
+ *
+ * @param "state" [in][out] The colony, its stock and its positional index.
+ *
+ * @param "journal" [in][out] Optional journal, the change is recorded in it.
+ *
+ * @note represents button 13 in CLI menu
+ *
+ * @see ColonyConstructFirstFit
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ConstructManyBuildings(colonyState& state, colonyJournal* journal) {
+
+    char buildingType;
+    long long count;
+    cout << "Please enter the building type:" << endl;
+    cin >> buildingType;
+    cout << "Please enter the number of buildings:" << endl;
+    cin >> count;
+
+    long long built = 0;
+    colonyStatus status = ColonyConstructFirstFit(state, buildingType, count, built);
+
+    if (status.result == COLONY_UNKNOWN_TYPE) {
+        cout << "Building type " << buildingType << " is not found in the consumption DLL." << endl;
+        return;
+    }
+    if (status.result == COLONY_BAD_INDEX) {
+        cout << "Invalid number of buildings " << count << endl;
+        return;
+    }
+    if (status.result == COLONY_INSUFFICIENT) {
+        cout << "Insufficient resource " << status.detail << endl;
+    }
+
+    if (journal != NULL && built > 0 && !JournalAppend(*journal, JOURNAL_CONSTRUCT_FIRST_FIT, buildingType, count, built)) PrintJournalFailure(*journal);
+
+    cout << built << " buildings of type " << buildingType << " have been added at the first empty blocks." << endl;
+}
+
+
+
+
+/* @brief Destructs the first buildings of one type, or all of them, refunding their resources at once.
+ *
+ * @param "state" [in][out] The colony, its stock and its positional index.
+ *
+ * @param "journal" [in][out] Optional journal, the change is recorded in it.
+ *
+ * @note represents button 14 in CLI menu, a number of 0 destructs every building of the type
+ *
+ * @see ColonyDestroyMany
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void DeleteManyBuildings(colonyState& state, colonyJournal* journal) {
+
+    char buildingType;
+    long long count;
+    cout << "Please enter the building type:" << endl;
+    cin >> buildingType;
+    cout << "Please enter the number of buildings (0 for all):" << endl;
+    cin >> count;
+
+    if (count < 0) {
+        cout << "Invalid number of buildings " << count << endl;
+        return;
+    }
+
+    long long destroyed = 0, limit = count == 0 ? LLONG_MAX : count;
+    if (ColonyDestroyMany(state, buildingType, limit, destroyed).result == COLONY_NOT_FOUND) {
+        cout << "Building of type " << buildingType << " not found in the colony." << endl;
+        return;
+    }
+
+    if (journal != NULL && !JournalAppend(*journal, JOURNAL_DESTROY_MANY, buildingType, limit, destroyed)) PrintJournalFailure(*journal);
+
+    cout << destroyed << " buildings of type " << buildingType << " have been deleted from the colony." << endl;
+}
+
+
+
+
+/* @brief Destructs every building in a range of blocks, refunding their resources at once.
+ *
+ * @param "state" [in][out] The colony, its stock and its positional index.
+ *
+ * @param "journal" [in][out] Optional journal, the change is recorded in it.
+ *
+ * @note represents button 15 in CLI menu, blocks are numbered from 1 as printed by button 5 and the last one is excluded
+ *
+ * @see ColonyDestroyRange
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void DeleteBuildingRange(colonyState& state, colonyJournal* journal) {
+
+    long long first, end;
+    cout << "Please enter the first block and the block after the last one:" << endl;
+    cin >> first >> end;
+
+    long long destroyed = 0;
+    colonyStatus status = ColonyDestroyRange(state, first, end, destroyed);
+
+    if (status.result == COLONY_BAD_INDEX) {
+        cout << "Invalid block range " << first << " " << end << endl;
+        return;
+    }
+    if (status.result == COLONY_NOT_FOUND) {
+        cout << "No building found in the blocks " << first << " to " << end << "." << endl;
+        return;
+    }
+
+    if (journal != NULL && !JournalAppend(*journal, JOURNAL_DESTROY_RANGE, '\0', first, end)) PrintJournalFailure(*journal);
+
+    cout << destroyed << " buildings have been deleted from the blocks " << first << " to " << end << "." << endl;
+}
+
+
+
+
+/* @brief Entry point of the batch mode (Space_Colony_Management_Upgraded --batch stock consumption colony commands).
+ *
+ * @post Loads the three input files like the menu does, replays the command file with RunBatch and renders the report,
+ *       a summary line, the colony (as menu option 3) and the stock (as menu option 7) into one buffer that is emitted
+ *       with a single write. Returns the exit code of the program.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int BatchMain(const string& stockFilename, const string& consumptionFilename, const string& colonyFilename, const string& commandFilename) {
+
+    mappedFile commandFile;
+    if (!MapFile(commandFilename, commandFile)) {
+        cout << "Unable to open the file " << commandFilename << "." << endl;
+        return 1;
+    }
+
+    colonyState state;
+    colonyStatus status = ColonyStateLoad(state, stockFilename, consumptionFilename, colonyFilename);
+
+    if (status.result != COLONY_OK) {
+        PrintLoadFailure(status);
+        UnmapFile(commandFile);
+        return 1;
+    }
+
+    vector<batchCommand> commands;
+    BatchParse(commandFile.data, commandFile.data + commandFile.size, commands);
+    UnmapFile(commandFile);
+
+    batchStats stats;
+    string report;
+    RunBatch(commands, state.colonyHead, state.colonyTail, state.stockHead, state.table, state.index, stats, report);
+
+    report += "Batch: " + to_string(stats.commands) + " commands, " + to_string(stats.constructed) + " constructed, " +
+              to_string(stats.destroyed) + " destroyed, " + to_string(stats.failed) + " failed.\n";
+
+
+    // Single final render
+    const char* colonyHeader = "Colony DLL:\n";
+    const char* stockHeader = "Stock DLL:\n";
+    const char* empty = "The list is empty !\n";
+
+    size_t colonyLength = state.colonyHead == NULL ? strlen(empty) : BuildingTypesLength(state.colonyHead) + 1 + EncodedColonyLength(state.colonyHead) + 1;
+    size_t stockLength = state.stockHead == NULL ? strlen(empty) : strlen(stockHeader) + StockLength(state.stockHead);
+
+    string buffer(report.size() + strlen(colonyHeader) + colonyLength + stockLength, '\0');
+
+    char* out = RenderText(report.c_str(), &buffer[0]);
+    out = RenderText(colonyHeader, out);
+    if (state.colonyHead == NULL) {
+        out = RenderText(empty, out);
+    } else {
+        out = RenderBuildingTypes(state.colonyHead, out);
+        *out++ = '\n';
+        out = RenderEncodedColony(state.colonyHead, out);
+        *out++ = '\n';
+    }
+    if (state.stockHead == NULL) {
+        RenderText(empty, out);
+    } else {
+        out = RenderText(stockHeader, out);
+        RenderStock(state.stockHead, out);
+    }
+
+    EmitBuffer(buffer);
+
+
+    ColonyStateFree(state);
+
+    return 0;
+}
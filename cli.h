@@ -0,0 +1,29 @@
+// Console front end over the colony API: prompting, messages, the batch mode entry point
+
+#ifndef _CLI_
+#define _CLI_
+
+#include <fstream>
+#include <string>
+#include "colony.h"
+#include "journal.h"
+
+using namespace std;
+
+// Function prototypes
+//------------------------------------------------------------------------------------------
+string fileOpenner(ifstream &file, string typeOfInput);
+void PrintLoadFailure(const colonyStatus& status);
+void PrintJournalFailure(const colonyJournal& journal);
+void DeleteBuildingFromColony(colonyState& state, char buildingType, colonyJournal* journal = NULL);
+void ConstructNewBuilding(colonyState& state, colonyJournal* journal = NULL);
+void SaveColonySnapshot(const colonyState& state);
+void LoadColonySnapshot(colonyState& state, colonyJournal* journal = NULL);
+void SaveTrustedFiles(colonyState& state, colonyJournal* journal = NULL);
+void PrintTotalConsumption(const colonyState& state);
+void ConstructManyBuildings(colonyState& state, colonyJournal* journal = NULL);
+void DeleteManyBuildings(colonyState& state, colonyJournal* journal = NULL);
+void DeleteBuildingRange(colonyState& state, colonyJournal* journal = NULL);
+int BatchMain(const string& stockFilename, const string& consumptionFilename, const string& colonyFilename, const string& commandFilename);
+//------------------------------------------------------------------------------------------
+#endif
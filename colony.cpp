@@ -0,0 +1,733 @@
+#include "colony.h"
+#include "ledger.h"
+#include "mapped.h"
+#include "render.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAVE_POSIX_PWRITE
+#endif
+
+//#define DEBUG
+//#define MMAP_INPUT // parse the input files straight from memory mapped bytes instead of iostreams (or configure with -DCOLONY_MMAP_INPUT=ON)
+
+/* @brief Checksum of the stock balances and the recipes, where the checksum of a trusted save starts.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static unsigned long long StockRecipesChecksum(const colonyState& state) {
+
+    unsigned long long hash = SnapshotChecksum(NULL, 0);
+
+    for (stockNode* ptr = state.stockHead; ptr != NULL; ptr = ptr->next) {
+        hash = SnapshotChecksum(ptr->resourceName.data(), ptr->resourceName.size(), HashWord(hash, ptr->resourceName.size()));
+        hash = HashWord(hash, (unsigned int)ptr->resourceQuantity);
+    }
+
+    for (consumpNode* ptr = state.consumpHead; ptr != NULL; ptr = ptr->next) {
+        hash = HashWord(hash, (unsigned long long)(unsigned char)ptr->buildType << 32 | ptr->consumpQtys.size());
+        for (int q : ptr->consumpQtys) {
+            hash = HashWord(hash, (unsigned int)q);
+        }
+    }
+
+    return hash;
+}
+
+
+
+
+/* @brief Blocks of the decoded colony, i.e. the length of its line in a colony file.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static long long ColonyBlocks(const colonyState& state) {
+
+    return ColonyIndexTotalEmptyBlocks(state.index) + (state.index.root != NULL ? state.index.root->nodeCount : 0);
+}
+
+
+
+
+/* @brief Reads the "#trusted <checksum>" line a stock file written by ColonyStateSaveTrusted ends with.
+ *
+ * @return false for an ordinary stock file (or one that can not be opened), the loaders then check every building.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static bool TrustedChecksum(const string& stockFilename, unsigned long long& checksum) {
+
+    ifstream file(stockFilename.c_str());
+    string line;
+
+    while (getline(file, line)) {
+        if (line.compare(0, 9, "#trusted ") == 0) {
+            const char* end = line.data() + line.size();
+            if (!line.empty() && line.back() == '\r') end--;
+            from_chars_result res = from_chars(line.data() + 9, end, checksum, 16);
+            return res.ec == errc() && res.ptr == end;
+        }
+    }
+    return false;
+}
+
+
+
+
+/* @brief Loads the stock, consumption and colony files into a fresh state.
+ *
+ * @param "state" [out] The state to be filled, expected to be empty.
+ *
+ * @param "stats" [out] Optional, receives the throughput of the colony loader.
+ *
+ * @return COLONY_OK, COLONY_OPEN_FAILED (detail = the file name) or the failure of the colony loader.
+ *         COLONY_BAD_SNAPSHOT (detail = the stock file name) if a trusted stock file does not match the files loaded with it.
+ *         On failure the state is freed again.
+ *
+ * @post A stock file written by ColonyStateSaveTrusted already holds the balances after construction: the colony is
+ *       then rebuilt without recipe lookups or stock deductions and the result is checked against the saved checksum.
+ *
+ * @note Debug code included
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyStateLoad(colonyState& state, const string& stockFilename, const string& consumptionFilename, const string& colonyFilename, colonyLoadStats* stats) {
+
+    colonyStatus status;
+
+    unsigned long long checksum = 0, hash = 0;
+    bool trusted = TrustedChecksum(stockFilename, checksum);
+
+#ifdef MMAP_INPUT
+    mappedFile stockFile, consumptionFile, colonyFile;
+
+    if (!MapFile(stockFilename, stockFile)) {
+        status = colonyStatus(COLONY_OPEN_FAILED, '\0', stockFilename);
+    } else if (!MapFile(consumptionFilename, consumptionFile)) {
+        status = colonyStatus(COLONY_OPEN_FAILED, '\0', consumptionFilename);
+    } else if (!MapFile(colonyFilename, colonyFile)) {
+        status = colonyStatus(COLONY_OPEN_FAILED, '\0', colonyFilename);
+    } else {
+        StockLoaderMapped(stockFile, state.stockHead, state.stockTail);
+        ConsumptionLoaderMapped(consumptionFile, state.consumpHead, state.consumpTail, state.table);
+        if (trusted) {
+            status = ColonyLoaderMapped(state.colonyHead, state.colonyTail, state.stockHead, state.table, colonyFile, stats, &hash);
+        } else {
+            status = ColonyLoaderParallel(state.colonyHead, state.colonyTail, state.stockHead, state.table, colonyFile, 0, stats);
+        }
+    }
+
+    UnmapFile(stockFile);
+    UnmapFile(consumptionFile);
+    UnmapFile(colonyFile);
+#else
+    ifstream stockFile(stockFilename.c_str());
+    ifstream consumptionFile(consumptionFilename.c_str());
+    ifstream colonyFile(colonyFilename.c_str());
+
+    if (stockFile.fail()) return colonyStatus(COLONY_OPEN_FAILED, '\0', stockFilename);
+    if (consumptionFile.fail()) return colonyStatus(COLONY_OPEN_FAILED, '\0', consumptionFilename);
+    if (colonyFile.fail()) return colonyStatus(COLONY_OPEN_FAILED, '\0', colonyFilename);
+
+    StockLoader(stockFile, state.stockHead, state.stockTail);
+    ConsumptionLoader(consumptionFile, state.consumpHead, state.consumpTail, state.table);
+    status = ColonyLoader(state.colonyHead, state.colonyTail, state.stockHead, state.table, colonyFile, stats, trusted ? &hash : NULL);
+#endif
+
+    if (status.result == COLONY_OK && trusted && HashWord(StockRecipesChecksum(state), hash) != checksum) {
+        status = colonyStatus(COLONY_BAD_SNAPSHOT, '\0', stockFilename);
+    }
+
+    if (status.result != COLONY_OK) {
+        ColonyStateFree(state);
+        return status;
+    }
+
+    ColonyIndexBuild(state.colonyHead, state.index);
+
+    // A trusted colony file is one ColonyStateSaveTrusted wrote, the next save to it only has to patch it
+    if (trusted) {
+        state.text.filename = colonyFilename;
+        state.text.length = ColonyBlocks(state);
+        state.text.hash = hash;
+    }
+
+    #ifdef DEBUG
+    PrintStockDEBUG(state.stockHead);
+    PrintConsumptionDEBUG(state.consumpHead);
+    PrintColonyDEBUG(state.colonyHead);
+    #endif
+
+    return status;
+}
+
+
+
+
+/* @brief Colony part of the checksum of a trusted save: the sum of the ColonyBlockTerm of every building, the same sum
+ *        ColonyParseBlockTrusted adds up while loading.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static unsigned long long ColonyBlocksChecksum(const colonyState& state) {
+
+    unsigned long long sum = 0;
+    long long block = 0;
+
+    for (colonyNode* ptr = state.colonyHead; ptr != NULL; ptr = ptr->next) {
+        block += ptr->emptyBlocks2TheLeft + 1;
+        sum += ColonyBlockTerm(block, ptr->buildType);
+    }
+    return sum;
+}
+
+
+
+
+/* @brief Checksum of everything a trusted save vouches for: the stock balances, the recipes and the colony structure.
+ *
+ * @note Hashes the DLLs rather than the bytes of the files, so the line endings of the files do not matter.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+unsigned long long ColonyStateChecksum(const colonyState& state) {
+
+    return HashWord(StockRecipesChecksum(state), ColonyBlocksChecksum(state));
+}
+
+
+
+
+/* @brief Block of a building of the colony.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static long long BlockOfBuilding(colonyNode* node) {
+
+    return ColonyIndexEmptyBlocksBefore(node) + ColonyIndexBuildingsBefore(node) + 1;
+}
+
+
+
+
+/* @brief Block of the n'th empty block (counting from 1, past the last building if n is beyond the inner ones).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static long long BlockOfEmptyBlock(const colonyState& state, long long n) {
+
+    long long offset;
+    colonyNode* node = ColonyIndexFindEmptyBlock(state.index, n, offset);
+
+    return n + (node != NULL ? ColonyIndexBuildingsBefore(node) : (state.index.root != NULL ? state.index.root->nodeCount : 0));
+}
+
+
+
+
+/* @brief Whether the blocks changed by a mutation are recorded, i.e. a colony file or a published view is tracked.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static bool TracksBlocks(const colonyState& state) {
+
+    return state.text.length >= 0 || state.published.publisher != NULL;
+}
+
+
+
+
+/* @brief Adds the block range [first, end) to a list of dirty ranges.
+ *
+ * @post Past COLONY_DIRTY_MAX ranges they are folded into the one range that covers them all, which over-approximates
+ *       but is never wrong: a save writes, and a publication copies, the current blocks.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void AddDirty(vector<pair<long long, long long>>& dirty, long long first, long long end) {
+
+    dirty.push_back(make_pair(first, end));
+
+    if (dirty.size() > COLONY_DIRTY_MAX) {
+        pair<long long, long long> all = dirty[0];
+        for (const pair<long long, long long>& range : dirty) {
+            all.first = min(all.first, range.first);
+            all.second = max(all.second, range.second);
+        }
+        dirty.assign(1, all);
+    }
+}
+
+
+
+
+/* @brief Records that the blocks [first, end) have changed since the colony file was saved and since the last view.
+ *
+ * @post Nothing is recorded for what is not tracked (TracksBlocks).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void MarkDirty(colonyState& state, long long first, long long end) {
+
+    if (first >= end) return;
+
+    if (state.text.length >= 0) AddDirty(state.text.dirty, first, end);
+    if (state.published.publisher != NULL) AddDirty(state.published.dirty, first, end);
+}
+
+
+
+
+/* @brief Sum of the ColonyBlockTerm of the buildings among the bytes of the blocks [first, first + size).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static unsigned long long BlockTermsOf(const char* bytes, size_t size, long long first) {
+
+    unsigned long long sum = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (bytes[i] != '-') sum += ColonyBlockTerm(first + i, bytes[i]);
+    }
+    return sum;
+}
+
+
+
+
+/* @brief Rewrites only the changed blocks of the colony file written by the last save, in place.
+ *
+ * @param "hash" [out] Colony part of the checksum of the patched file.
+ *
+ * @return false if the file can not be patched (not POSIX, not the size it was saved with, or so much has changed that
+ *         writing it whole is cheaper), the caller then writes the whole file.
+ *
+ * @post The dirty ranges are sorted and merged (closer than COLONY_PATCH_SLACK bytes), rendered from the DLL starting at
+ *       the first building of each range (ColonyIndexFindBlock) and written with one pwrite each. A colony that grew
+ *       past the end of the file also gets the blocks in between and its newline written, one that shrank is truncated.
+ *       The bytes a range replaces are read first, so the checksum is updated by the terms of the changed blocks only.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static bool PatchColonyFile(const colonyState& state, const string& filename, unsigned long long& hash) {
+
+#if defined(HAVE_POSIX_PWRITE)
+    long long length = ColonyBlocks(state), saved = state.text.length, longest = max(length, saved);
+
+    vector<pair<long long, long long>> ranges(state.text.dirty);
+    if (length != saved) ranges.push_back(make_pair(min(length, saved) + 1, longest + 1));
+    sort(ranges.begin(), ranges.end());
+
+    vector<pair<long long, long long>> merged;
+    long long bytes = 0;
+
+    for (pair<long long, long long> range : ranges) {
+        range.second = min(range.second, longest + 1);
+        if (range.first >= range.second) continue;
+
+        if (!merged.empty() && range.first <= merged.back().second + COLONY_PATCH_SLACK) {
+            bytes += max(0LL, range.second - merged.back().second);
+            merged.back().second = max(merged.back().second, range.second);
+        } else {
+            bytes += range.second - range.first;
+            merged.push_back(range);
+        }
+    }
+
+    if (bytes * 2 > longest) return false;
+
+    int fd = open(filename.c_str(), O_RDWR);
+    if (fd < 0) return false;
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && st.st_size == saved + 1;
+
+    hash = state.text.hash;
+    string buffer;
+
+    for (size_t i = 0; ok && i < merged.size(); i++) {
+
+        long long first = merged[i].first;
+        long long oldEnd = min(merged[i].second, saved + 1), newEnd = min(merged[i].second, length + 1);
+
+        if (oldEnd > first) {
+            buffer.resize(oldEnd - first);
+            ok = pread(fd, &buffer[0], buffer.size(), first - 1) == (ssize_t)buffer.size();
+            hash -= BlockTermsOf(buffer.data(), buffer.size(), first);
+        }
+
+        if (ok && newEnd > first) {
+            long long position = 0;
+            colonyNode* node = ColonyIndexFindBlock(state.index, first, position);
+
+            buffer.resize(newEnd - first);
+            RenderColonyBlocks(node, position, first, newEnd, &buffer[0]);
+            hash += BlockTermsOf(buffer.data(), buffer.size(), first);
+            ok = pwrite(fd, buffer.data(), buffer.size(), first - 1) == (ssize_t)buffer.size();
+        }
+    }
+
+    if (ok && length != saved) {
+        ok = pwrite(fd, "\n", 1, length) == 1 && (length > saved || ftruncate(fd, length + 1) == 0);
+    }
+
+    close(fd);
+
+    #ifdef DEBUG
+    cout << "DEBUG: COLONY FILE PATCHED, " << merged.size() << " RANGES, " << bytes << " BYTES" << endl;
+    #endif
+
+    return ok;
+#else
+    return false;
+#endif
+}
+
+
+
+
+/* @brief Writes the stock and colony files of a state so that ColonyStateLoad can restart from them without checking
+ *        every building again.
+ *
+ * @param "stockFilename" [in] Receives the current balances as "name quantity" lines, followed by "#trusted <checksum>".
+ *
+ * @param "colonyFilename" [in] Receives the colony with its inner empty blocks, as in the input files.
+ *
+ * @return COLONY_OK, or COLONY_OPEN_FAILED (detail = the file name) if a file can not be written.
+ *
+ * @note The recipes are part of the checksum, so the files have to be loaded with the same consumption file.
+ *       Both are ordinary input files, a stock file that is edited by hand no longer matches and is refused.
+ *
+ * @post Saving again to the same colony file only rewrites the blocks changed since (PatchColonyFile), construction
+ *       and destruction never move the other blocks. Otherwise the colony file is written whole and tracked from then on.
+ *       A patch is not atomic like a whole write, a save cut short is caught by the checksum when the files are loaded.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyStateSaveTrusted(colonyState& state, const string& stockFilename, const string& colonyFilename) {
+
+    unsigned long long hash = 0;
+    bool patched = state.text.length >= 0 && state.text.filename == colonyFilename && PatchColonyFile(state, colonyFilename, hash);
+
+    if (!patched) {
+        string colony(DecodedColonyLength(state.colonyHead) + 1, '\n');
+        RenderDecodedColony(state.colonyHead, &colony[0]);
+
+        if (!WriteFileReplacing(colonyFilename, colony)) {
+            state.text = colonyTextFile();
+            return colonyStatus(COLONY_OPEN_FAILED, '\0', colonyFilename);
+        }
+        hash = ColonyBlocksChecksum(state);
+    }
+
+    state.text.filename = colonyFilename;
+    state.text.length = ColonyBlocks(state);
+    state.text.hash = hash;
+    state.text.dirty.clear();
+
+    string stock;
+    for (stockNode* ptr = state.stockHead; ptr != NULL; ptr = ptr->next) {
+        stock += ptr->resourceName;
+        stock += ' ';
+        stock += to_string(ptr->resourceQuantity);
+        stock += '\n';
+    }
+
+    char trailer[32];
+    snprintf(trailer, sizeof(trailer), "#trusted %016llx\n", HashWord(StockRecipesChecksum(state), hash));
+    stock += trailer;
+
+    if (!WriteFileReplacing(stockFilename, stock)) return colonyStatus(COLONY_OPEN_FAILED, '\0', stockFilename);
+
+    return colonyStatus(COLONY_OK);
+}
+
+
+
+
+/* @brief Places a building of a type on the index'th empty block (counting from 1), paying for it from the stock.
+ *
+ * @return COLONY_OK, COLONY_UNKNOWN_TYPE, COLONY_BAD_INDEX or COLONY_INSUFFICIENT (detail = the resource that ran short).
+ *         Nothing is changed unless COLONY_OK is returned.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyConstruct(colonyState& state, char buildType, int index) {
+
+    long long block = TracksBlocks(state) && index >= 1 ? BlockOfEmptyBlock(state, index) : 0;
+
+    stockNode* shortNode = NULL;
+    colonyResult result = ConstructBuilding(state.colonyHead, state.colonyTail, state.table, state.stockHead, buildType, index, shortNode, &state.index);
+
+    if (result == COLONY_OK) MarkDirty(state, block, block + 1);
+
+    return colonyStatus(result, buildType, result == COLONY_INSUFFICIENT ? shortNode->resourceName : "");
+}
+
+
+
+
+/* @brief Places a building whose resources have already been taken from the stock (ReserveResources) on the index'th
+ *        empty block, for a front end that asks for the block after the payment.
+ *
+ * @return COLONY_OK, or COLONY_BAD_INDEX if index < 1 (nothing is changed).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyPlaceReserved(colonyState& state, char buildType, int index) {
+
+    if (index < 1) return colonyStatus(COLONY_BAD_INDEX, buildType);
+
+    long long block = TracksBlocks(state) ? BlockOfEmptyBlock(state, index) : 0;
+
+    ColonyInsertAtEmptyBlock(state.colonyHead, state.colonyTail, buildType, index, &state.index);
+    MarkDirty(state, block, block + 1);
+
+    return colonyStatus(COLONY_OK);
+}
+
+
+
+
+/* @brief Pays for up to "count" buildings of a type at once, common part of ColonyConstructMany / ColonyConstructFirstFit.
+ *
+ * @param "granted" [out] How many of them the stock covers, found with one division per resource and deducted in one step.
+ *
+ * @return COLONY_OK if all of them are covered, otherwise COLONY_INSUFFICIENT (detail = the resource that ran short).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static colonyStatus ReserveMany(colonyState& state, char buildType, long long count, long long& granted) {
+
+    stockLedger ledger;
+    recipeMatrix matrix;
+    LedgerFromStock(state.stockHead, ledger);
+    RecipeMatrixBuild(state.table, ledger, matrix);
+
+    const long long* recipe = RecipeRow(matrix, buildType);
+
+    granted = LedgerAffordableTimes(ledger, recipe, count);
+    LedgerDeduct(ledger, recipe, granted);
+    LedgerToStock(ledger, state.stockHead);
+
+    if (granted < count) {
+        return colonyStatus(COLONY_INSUFFICIENT, buildType, ledger.names[LedgerFirstShortfall(ledger, recipe)]);
+    }
+    return colonyStatus(COLONY_OK, buildType);
+}
+
+
+
+
+/* @brief Places buildings of one type on several empty blocks, paying for all of them at once.
+ *
+ * @param "blocks" [in] 1-based empty block numbers, all counted on the colony as it is before the call (distinct, in any order).
+ *
+ * @param "built" [out] How many buildings have been placed.
+ *
+ * @return COLONY_OK, COLONY_UNKNOWN_TYPE or COLONY_BAD_INDEX (nothing is changed), or COLONY_INSUFFICIENT (detail = the
+ *         resource that ran short) when the stock only covers the first "built" blocks of the list, which are placed.
+ *
+ * @post One affordability computation, one deduction and one pass over the colony (ColonyInsertAtEmptyBlocks).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyConstructMany(colonyState& state, char buildType, const vector<long long>& blocks, long long& built) {
+
+    built = 0;
+
+    if (FindConsumption(state.table, buildType) == NULL) return colonyStatus(COLONY_UNKNOWN_TYPE, buildType);
+
+    vector<long long> sorted(blocks);
+    sort(sorted.begin(), sorted.end());
+
+    if (!sorted.empty() && (sorted.front() < 1 || sorted.back() > INT_MAX || adjacent_find(sorted.begin(), sorted.end()) != sorted.end())) {
+        return colonyStatus(COLONY_BAD_INDEX, buildType);
+    }
+
+    colonyStatus status = ReserveMany(state, buildType, blocks.size(), built);
+
+    if (built < (long long)blocks.size()) {
+        sorted.assign(blocks.begin(), blocks.begin() + built);
+        sort(sorted.begin(), sorted.end());
+    }
+
+    // Placing a building on an empty block does not move any other block
+    if (TracksBlocks(state)) {
+        for (long long n : sorted) {
+            long long block = BlockOfEmptyBlock(state, n);
+            MarkDirty(state, block, block + 1);
+        }
+    }
+
+    ColonyInsertAtEmptyBlocks(state.colonyHead, state.colonyTail, buildType, sorted, &state.index);
+
+    return status;
+}
+
+
+
+
+/* @brief Places "count" buildings of one type on the first empty blocks of the colony (inner gaps from the left, then
+ *        after the last building), paying for all of them at once.
+ *
+ * @param "built" [out] How many buildings have been placed.
+ *
+ * @return As ColonyConstructMany, COLONY_BAD_INDEX if count is negative or above INT_MAX.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyConstructFirstFit(colonyState& state, char buildType, long long count, long long& built) {
+
+    built = 0;
+
+    if (FindConsumption(state.table, buildType) == NULL) return colonyStatus(COLONY_UNKNOWN_TYPE, buildType);
+    if (count < 0 || count > INT_MAX) return colonyStatus(COLONY_BAD_INDEX, buildType);
+
+    colonyStatus status = ReserveMany(state, buildType, count, built);
+
+    vector<long long> blocks(built);
+    for (long long i = 0; i < built; i++) {
+        blocks[i] = i + 1;
+    }
+
+    if (TracksBlocks(state) && built > 0) {
+        MarkDirty(state, BlockOfEmptyBlock(state, 1), BlockOfEmptyBlock(state, built) + 1);
+    }
+
+    ColonyInsertAtEmptyBlocks(state.colonyHead, state.colonyTail, buildType, blocks, &state.index);
+
+    return status;
+}
+
+
+
+
+/* @brief Removes the first building of a type and gives its resources back to the stock.
+ *
+ * @return COLONY_OK or COLONY_NOT_FOUND.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyDestroy(colonyState& state, char buildType) {
+
+    colonyNode* node = TracksBlocks(state) ? ColonyIndexFindFirst(state.index, buildType) : NULL;
+    long long block = node != NULL ? BlockOfBuilding(node) : 0;
+
+    colonyResult result = DestroyBuilding(state.colonyHead, state.colonyTail, buildType, state.table, state.stockHead, &state.index);
+
+    if (result == COLONY_OK) MarkDirty(state, block, block + 1);
+
+    return colonyStatus(result, buildType);
+}
+
+
+
+
+/* @brief Sums the recipes of a number of buildings of each type, per stock resource.
+ *
+ * @param "counts" [in] counts[c] is the number of buildings of type c (256 entries).
+ *
+ * @param "totals" [out] totals[i] belongs to the i'th stock node: the sum over the building types of counts[c] times the
+ *                       recipe entry (entries past the last stock node are ignored, as when a building is paid for).
+ *                       Types without a recipe add nothing.
+ *
+ * @post The inner loop is a plain widening multiply-add over the recipe, which the compiler vectorizes.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void RecipeTotals(const colonyState& state, const long long* counts, vector<long long>& totals) {
+
+    int size = 0;
+    for (stockNode* ptr = state.stockHead; ptr != NULL; ptr = ptr->next) size++;
+
+    totals.assign(size, 0);
+    long long* out = totals.data();
+
+    for (int c = 0; c < 256; c++) {
+
+        long long count = counts[c];
+        consumpNode* recipe = count == 0 ? NULL : FindConsumption(state.table, (char)c);
+        if (recipe == NULL) continue;
+
+        const int* qtys = recipe->consumpQtys.data();
+        int n = min(size, (int)recipe->consumpQtys.size());
+
+        for (int i = 0; i < n; i++) {
+            out[i] += count * qtys[i];
+        }
+    }
+}
+
+
+
+
+/* @brief Gives the summed recipes of removed buildings back to the stock in one walk.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void RefundMany(colonyState& state, const long long* counts) {
+
+    vector<long long> totals;
+    RecipeTotals(state, counts, totals);
+
+    size_t i = 0;
+    for (stockNode* ptr = state.stockHead; ptr != NULL; ptr = ptr->next, i++) {
+        ptr->resourceQuantity += (int)totals[i];
+    }
+}
+
+
+
+
+/* @brief Removes the first "limit" buildings of a type and gives their resources back to the stock.
+ *
+ * @param "limit" [in] How many to remove at most, LLONG_MAX for every building of the type.
+ *
+ * @param "destroyed" [out] Number of removed buildings.
+ *
+ * @return COLONY_OK, or COLONY_NOT_FOUND if there was no building of the type.
+ *
+ * @post Same colony and stock as "destroyed" ColonyDestroy calls, but the colony is walked once (ColonyRemoveType)
+ *       and the resources are refunded once for the whole lot.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyDestroyMany(colonyState& state, char buildType, long long limit, long long& destroyed) {
+
+    // From the first building of the type to the end, the last one removed is only known afterwards
+    colonyNode* node = TracksBlocks(state) && limit > 0 ? ColonyIndexFindFirst(state.index, buildType) : NULL;
+    if (node != NULL) MarkDirty(state, BlockOfBuilding(node), ColonyBlocks(state) + 1);
+
+    destroyed = ColonyRemoveType(state.colonyHead, state.colonyTail, buildType, limit, &state.index);
+    if (destroyed == 0) return colonyStatus(COLONY_NOT_FOUND, buildType);
+
+    long long counts[256] = {0};
+    counts[(unsigned char)buildType] = destroyed;
+    RefundMany(state, counts);
+
+    return colonyStatus(COLONY_OK);
+}
+
+
+
+
+/* @brief Removes every building in the blocks [first, end) and gives their resources back to the stock.
+ *
+ * @param "first" / "end" [in] Block range, blocks count every position (empty or not) from 1, as the colony is printed
+ *                             with its inner empty blocks.
+ *
+ * @param "destroyed" [out] Number of removed buildings.
+ *
+ * @return COLONY_OK, COLONY_BAD_INDEX if first < 1 or end < first, COLONY_NOT_FOUND if the range holds no building.
+ *
+ * @post One pass over the range (ColonyRemoveRange), one refund for the whole lot.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyDestroyRange(colonyState& state, long long first, long long end, long long& destroyed) {
+
+    destroyed = 0;
+    if (first < 1 || end < first) return colonyStatus(COLONY_BAD_INDEX);
+
+    long long counts[256];
+    destroyed = ColonyRemoveRange(state.colonyHead, state.colonyTail, first, end, counts, &state.index);
+    if (destroyed == 0) return colonyStatus(COLONY_NOT_FOUND);
+
+    MarkDirty(state, first, end);
+
+    RefundMany(state, counts);
+
+    return colonyStatus(COLONY_OK);
+}
+
+
+
+
+/* @brief What the colony as a whole consumes, per stock resource.
+ *
+ * @param "totals" [out] totals[i] belongs to the i'th stock node, as in RecipeTotals.
+ *
+ * @post The counts come from the type table the positional index keeps up to date, so the cost is
+ *       (building types x resources) no matter how large the colony is and the colony DLL is not visited.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ColonyTotalConsumption(const colonyState& state, vector<long long>& totals) {
+
+    RecipeTotals(state, state.index.typeCount, totals);
+}
+
+
+
+
+/* @brief Deletes every DLL of the state and leaves it empty.
+ *
+ * @note The colony nodes are deleted one by one: other states on the same thread share the node pool, so
+ *       ReleaseAll is only safe for the last colony of a thread (menu option 8 does that before calling this).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ColonyStateFree(colonyState& state) {
+
+    DeleteAll(state.stockHead);
+    DeleteAll(state.consumpHead);
+    DeleteAll(state.colonyHead);
+
+    state = colonyState();
+}
@@ -0,0 +1,78 @@
+// Prompt-free colony API, everything a client (the menu, batch mode, benchmarks, a server) needs to drive one colony
+
+#ifndef _COLONY_
+#define _COLONY_
+
+#include <string>
+#include <vector>
+#include "functions.h"
+#include "colonyindex.h"
+
+using namespace std;
+
+#define COLONY_DIRTY_MAX 4096       // dirty ranges kept before they are folded into one
+#define COLONY_PATCH_SLACK 4096     // dirty ranges closer than this many bytes are written as one
+
+// Struct definitions
+//------------------------------------------------------------------------------------------
+// The colony file last written by ColonyStateSaveTrusted and the blocks changed since, so the next save to the same file
+// only rewrites those bytes. Blocks count every position (empty or not) from 1, block b is byte b - 1 of the file.
+struct colonyTextFile{
+
+    string filename;
+    long long length;                           // blocks in the file (its newline excluded), -1 while nothing is tracked
+    unsigned long long hash;                    // colony part of the trusted checksum of the file (ColonyBlockTerm sum)
+    vector<pair<long long, long long>> dirty;   // block ranges [first, end) changed since the save
+
+    colonyTextFile() : length(-1), hash(0) {}
+};
+
+struct colonyPublisher;
+
+// The blocks changed since the last ColonyPublish (colonyview.h), so the next view only rebuilds the chunks that cover
+// them. Nothing is recorded until the state has been published, and only for the publisher it was published to last.
+struct colonyViewChanges{
+
+    const colonyPublisher* publisher;           // where the last view went, NULL while the state has not been published
+    vector<pair<long long, long long>> dirty;   // block ranges [first, end) changed since that view
+
+    colonyViewChanges() : publisher(NULL) {}
+};
+
+// One colony with its stock and recipes. The DLLs belong to the state, free them with ColonyStateFree.
+struct colonyState{
+
+    stockNode* stockHead;
+    stockNode* stockTail;
+
+    consumpNode* consumpHead;
+    consumpNode* consumpTail;
+    consumpTable table;
+
+    colonyNode* colonyHead;
+    colonyNode* colonyTail;
+    colonyIndex index;
+
+    colonyTextFile text;
+    colonyViewChanges published;
+
+    colonyState() : stockHead(NULL), stockTail(NULL), consumpHead(NULL), consumpTail(NULL), colonyHead(NULL), colonyTail(NULL) {}
+};
+//------------------------------------------------------------------------------------------
+//
+// Function prototypes
+//------------------------------------------------------------------------------------------
+colonyStatus ColonyStateLoad(colonyState& state, const string& stockFilename, const string& consumptionFilename, const string& colonyFilename, colonyLoadStats* stats = NULL);
+unsigned long long ColonyStateChecksum(const colonyState& state);
+colonyStatus ColonyStateSaveTrusted(colonyState& state, const string& stockFilename, const string& colonyFilename);
+colonyStatus ColonyConstruct(colonyState& state, char buildType, int index);
+colonyStatus ColonyPlaceReserved(colonyState& state, char buildType, int index);
+colonyStatus ColonyConstructMany(colonyState& state, char buildType, const vector<long long>& blocks, long long& built);
+colonyStatus ColonyConstructFirstFit(colonyState& state, char buildType, long long count, long long& built);
+colonyStatus ColonyDestroy(colonyState& state, char buildType);
+colonyStatus ColonyDestroyMany(colonyState& state, char buildType, long long limit, long long& destroyed);
+colonyStatus ColonyDestroyRange(colonyState& state, long long first, long long end, long long& destroyed);
+void ColonyTotalConsumption(const colonyState& state, vector<long long>& totals);
+void ColonyStateFree(colonyState& state);
+//------------------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,425 @@
+#include "colonyindex.h"
+
+//#define DEBUG
+
+/* @brief Next treap priority (xorshift32).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static unsigned NextPriority(colonyIndex& index) {
+
+    unsigned x = index.seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    index.seed = x;
+    return x;
+}
+
+
+
+
+/* @brief The typeMask bit of a building type. Types 64 apart share a bit, the letters the recipes use never do.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static unsigned long long TypeBit(char buildType) {
+    return 1ULL << ((unsigned char)buildType & 63);
+}
+
+
+
+
+/* @brief Recomputes the subtree sums of a node from its children.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void Pull(colonyNode* node) {
+
+    node->gapSum = node->emptyBlocks2TheLeft;
+    node->nodeCount = 1;
+
+    node->typeMask = TypeBit(node->buildType);
+
+    if (node->left != NULL) {
+        node->gapSum += node->left->gapSum;
+        node->nodeCount += node->left->nodeCount;
+        node->typeMask |= node->left->typeMask;
+    }
+    if (node->right != NULL) {
+        node->gapSum += node->right->gapSum;
+        node->nodeCount += node->right->nodeCount;
+        node->typeMask |= node->right->typeMask;
+    }
+}
+
+
+
+
+/* @brief Whether a building of the given type may be in the subtree of node. false is exact, true may also come from a
+ *        type sharing its typeMask bit, so a search that follows it has to be ready to come back empty handed.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static bool HasType(colonyNode* node, char buildType) {
+    return node != NULL && (node->typeMask & TypeBit(buildType)) != 0;
+}
+
+
+
+
+/* @brief The first (leftmost) building of a type in the subtree of node, NULL if there is none.
+ *
+ * @note Only enters subtrees whose typeMask has the bit of the type. Without another type on the same bit every
+ *       subtree it enters has the type, so it walks one path down, O(log n) expected.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static colonyNode* FirstOfType(colonyNode* node, char buildType) {
+
+    if (!HasType(node, buildType)) return NULL;
+
+    colonyNode* found = FirstOfType(node->left, buildType);
+    if (found != NULL) return found;
+
+    if (node->buildType == buildType) return node;
+
+    return FirstOfType(node->right, buildType);
+}
+
+
+
+
+/* @brief Recomputes the sums from a node up to the root.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void PullPath(colonyNode* node) {
+
+    while (node != NULL) {
+        Pull(node);
+        node = node->parent;
+    }
+}
+
+
+
+
+/* @brief Rotates a node above its parent, in-order (DLL) order is preserved.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void RotateUp(colonyIndex& index, colonyNode* node) {
+
+    colonyNode* parent = node->parent;
+    colonyNode* grand = parent->parent;
+
+    if (parent->left == node) {
+        parent->left = node->right;
+        if (node->right != NULL) node->right->parent = parent;
+        node->right = parent;
+    } else {
+        parent->right = node->left;
+        if (node->left != NULL) node->left->parent = parent;
+        node->left = parent;
+    }
+
+    parent->parent = node;
+    node->parent = grand;
+
+    if (grand == NULL) {
+        index.root = node;
+    } else if (grand->left == parent) {
+        grand->left = node;
+    } else {
+        grand->right = node;
+    }
+
+    Pull(parent);
+    Pull(node);
+}
+
+
+
+
+/* @brief Lays a fresh treap over an existing colony DLL in O(n).
+ *
+ * @param "head" [in] Pointer to the head of the colony DLL.
+ *
+ * @param "index" [out] The index to be (re)built.
+ *
+ * @post The nodes are inserted in DLL order with a stack of the rightmost path (Cartesian tree construction),
+ *       a node's sums are final once it leaves the stack.
+ *
+ * @note Call it after bulk operations that bypass the index (loaders, encodeColony).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ColonyIndexBuild(colonyNode* head, colonyIndex& index) {
+
+    vector<colonyNode*> stack;
+
+    for (int i = 0; i < 256; i++) index.typeCount[i] = 0;
+
+    for (colonyNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+
+        index.typeCount[(unsigned char)ptr->buildType]++;
+
+        ptr->priority = NextPriority(index);
+        ptr->left = ptr->right = ptr->parent = NULL;
+
+        colonyNode* last = NULL;
+        while (!stack.empty() && stack.back()->priority < ptr->priority) {
+            last = stack.back();
+            stack.pop_back();
+            Pull(last);
+        }
+
+        ptr->left = last;
+        if (last != NULL) last->parent = ptr;
+
+        if (!stack.empty()) {
+            stack.back()->right = ptr;
+            ptr->parent = stack.back();
+        }
+        stack.push_back(ptr);
+    }
+
+    for (int i = (int)stack.size() - 1; i >= 0; i--) {
+        Pull(stack[i]);
+    }
+
+    index.root = stack.empty() ? NULL : stack[0];
+}
+
+
+
+
+/* @brief Finds the node whose gap owns the n'th empty block (counting from 1 on the left).
+ *
+ * @param "offset" [out] Position of that empty block inside the gap (1 = leftmost dash of the gap).
+ *                       If n is beyond the last empty block, it receives how far beyond (n - total empty blocks).
+ *
+ * @return The owning node, NULL if n is beyond the last empty block of the colony.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyNode* ColonyIndexFindEmptyBlock(const colonyIndex& index, long long n, long long& offset) {
+
+    colonyNode* node = index.root;
+
+    while (node != NULL) {
+
+        long long leftGaps = node->left != NULL ? node->left->gapSum : 0;
+
+        if (n <= leftGaps) {
+            node = node->left;
+        } else if (n <= leftGaps + node->emptyBlocks2TheLeft) {
+            offset = n - leftGaps;
+            return node;
+        } else {
+            n -= leftGaps + node->emptyBlocks2TheLeft;
+            node = node->right;
+        }
+    }
+
+    offset = n;
+    return NULL;
+}
+
+
+
+
+/* @brief Number of empty blocks on the left of a building (its own gap included).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+long long ColonyIndexEmptyBlocksBefore(colonyNode* node) {
+
+    long long count = node->emptyBlocks2TheLeft + (node->left != NULL ? node->left->gapSum : 0);
+
+    for (; node->parent != NULL; node = node->parent) {
+        colonyNode* parent = node->parent;
+        if (parent->right == node) {
+            count += parent->emptyBlocks2TheLeft + (parent->left != NULL ? parent->left->gapSum : 0);
+        }
+    }
+    return count;
+}
+
+
+
+
+/* @brief Number of buildings on the left of a building, i.e. its 0-based position in the DLL.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+long long ColonyIndexBuildingsBefore(colonyNode* node) {
+
+    long long count = node->left != NULL ? node->left->nodeCount : 0;
+
+    for (; node->parent != NULL; node = node->parent) {
+        colonyNode* parent = node->parent;
+        if (parent->right == node) {
+            count += 1 + (parent->left != NULL ? parent->left->nodeCount : 0);
+        }
+    }
+    return count;
+}
+
+
+
+
+/* @brief Finds the first building at or after a block of the colony, counting every block (empty or not) from 1 on the
+ *        left, as the colony is printed with its inner empty blocks.
+ *
+ * @param "position" [out] Block of the returned building.
+ *
+ * @return The building, NULL if every building is left of block.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyNode* ColonyIndexFindBlock(const colonyIndex& index, long long block, long long& position) {
+
+    colonyNode* node = index.root;
+    colonyNode* found = NULL;
+    long long offset = 0; // blocks left of the current subtree
+
+    while (node != NULL) {
+
+        long long leftBlocks = node->left != NULL ? node->left->gapSum + node->left->nodeCount : 0;
+        long long nodeBlock = offset + leftBlocks + node->emptyBlocks2TheLeft + 1;
+
+        if (nodeBlock >= block) {
+            found = node;
+            position = nodeBlock;
+            node = node->left;
+        } else {
+            offset = nodeBlock;
+            node = node->right;
+        }
+    }
+    return found;
+}
+
+
+
+
+/* @brief Empty blocks of the whole colony (trailing dashes are never stored).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+long long ColonyIndexTotalEmptyBlocks(const colonyIndex& index) {
+    return index.root != NULL ? index.root->gapSum : 0;
+}
+
+
+
+
+/* @brief Finds the first (leftmost) building of a type.
+ *
+ * @return The node, NULL if the colony has no building of that type (answered in O(1) from typeCount).
+ *
+ * @note Descends towards the leftmost subtree whose typeMask has the type (FirstOfType), O(log n) expected.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyNode* ColonyIndexFindFirst(const colonyIndex& index, char buildType) {
+
+    if (index.typeCount[(unsigned char)buildType] == 0) return NULL;
+
+    return FirstOfType(index.root, buildType);
+}
+
+
+
+
+/* @brief Finds the next building of a type after a building, without walking the DLL in between.
+ *
+ * @param "node" [in] A building of the indexed colony.
+ *
+ * @return The first building of the type right of node, NULL if there is none.
+ *
+ * @note Climbs until an ancestor or a subtree to the right has the type and descends into it as ColonyIndexFindFirst,
+ *       O(log n) expected.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyNode* ColonyIndexFindNext(colonyNode* node, char buildType) {
+
+    colonyNode* found = FirstOfType(node->right, buildType);
+    if (found != NULL) return found;
+
+    // Up the ancestors reached from their left side: each one, then its right subtree, comes next in list order
+    while (node->parent != NULL) {
+        colonyNode* parent = node->parent;
+        if (parent->left == node) {
+            if (parent->buildType == buildType) return parent;
+
+            found = FirstOfType(parent->right, buildType);
+            if (found != NULL) return found;
+        }
+        node = parent;
+    }
+    return NULL;
+}
+
+
+
+
+/* @brief Adds a node that has just been linked into the DLL to the index.
+ *
+ * @param "node" [in][out] The new node, already linked right before pos in the DLL.
+ *
+ * @param "pos" [in] Its DLL successor, NULL if the node has been appended as the new tail.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ColonyIndexInsertBefore(colonyIndex& index, colonyNode* node, colonyNode* pos) {
+
+    node->left = node->right = node->parent = NULL;
+    node->priority = NextPriority(index);
+    Pull(node);
+
+    index.typeCount[(unsigned char)node->buildType]++;
+
+    if (index.root == NULL) {
+        index.root = node;
+        return;
+    }
+
+    // The in-order predecessor slot of pos: its left child if free, otherwise right of the rightmost node of its left subtree
+    colonyNode* attach;
+    if (pos == NULL) {
+        attach = index.root;
+        while (attach->right != NULL) attach = attach->right;
+        attach->right = node;
+    } else if (pos->left == NULL) {
+        attach = pos;
+        attach->left = node;
+    } else {
+        attach = pos->left;
+        while (attach->right != NULL) attach = attach->right;
+        attach->right = node;
+    }
+
+    node->parent = attach;
+    PullPath(attach);
+
+    while (node->parent != NULL && node->priority > node->parent->priority) {
+        RotateUp(index, node);
+    }
+}
+
+
+
+
+/* @brief Takes a node out of the index, call it before the node is unlinked from the DLL and deleted.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ColonyIndexRemove(colonyIndex& index, colonyNode* node) {
+
+    index.typeCount[(unsigned char)node->buildType]--;
+
+    // Rotate the node down until it is a leaf
+    while (node->left != NULL || node->right != NULL) {
+
+        colonyNode* child;
+        if (node->right == NULL || (node->left != NULL && node->left->priority > node->right->priority)) {
+            child = node->left;
+        } else {
+            child = node->right;
+        }
+        RotateUp(index, child);
+    }
+
+    colonyNode* parent = node->parent;
+    if (parent == NULL) {
+        index.root = NULL;
+    } else {
+        if (parent->left == node) {
+            parent->left = NULL;
+        } else {
+            parent->right = NULL;
+        }
+        PullPath(parent);
+    }
+
+    node->parent = NULL;
+}
+
+
+
+
+/* @brief Propagates a change of node->emptyBlocks2TheLeft to the sums above it.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ColonyIndexGapChanged(colonyNode* node) {
+    PullPath(node);
+}
@@ -0,0 +1,45 @@
+// Positional index over the colony DLL
+
+#ifndef _COLONYINDEX_
+#define _COLONYINDEX_
+
+#include <vector>
+#include "functions.h"
+
+using namespace std;
+
+// Struct definitions
+//------------------------------------------------------------------------------------------
+// Root of a treap laid over the colony nodes (the left/right/parent fields of colonyNode). An in-order walk of the treap
+// visits the nodes in DLL order and every node knows the empty blocks (gapSum) and buildings (nodeCount) of its subtree,
+// which answers positional questions in O(log n) expected time instead of walking the DLL.
+// The typeMask of the subtrees (one bit per type, types 64 apart share it) and typeCount find the first building of a
+// type the same way.
+struct colonyIndex{
+
+    colonyNode* root;
+    unsigned seed;      // xorshift state for the node priorities
+
+    long long typeCount[256];   // buildings of each type in the colony
+
+    colonyIndex() : root(NULL), seed(2463534242u) {
+        for (int i = 0; i < 256; i++) typeCount[i] = 0;
+    }
+};
+//------------------------------------------------------------------------------------------
+//
+// Function prototypes
+//------------------------------------------------------------------------------------------
+void ColonyIndexBuild(colonyNode* head, colonyIndex& index);
+colonyNode* ColonyIndexFindEmptyBlock(const colonyIndex& index, long long n, long long& offset);
+long long ColonyIndexEmptyBlocksBefore(colonyNode* node);
+long long ColonyIndexBuildingsBefore(colonyNode* node);
+colonyNode* ColonyIndexFindBlock(const colonyIndex& index, long long block, long long& position);
+long long ColonyIndexTotalEmptyBlocks(const colonyIndex& index);
+colonyNode* ColonyIndexFindFirst(const colonyIndex& index, char buildType);
+colonyNode* ColonyIndexFindNext(colonyNode* node, char buildType);
+void ColonyIndexInsertBefore(colonyIndex& index, colonyNode* node, colonyNode* pos);
+void ColonyIndexRemove(colonyIndex& index, colonyNode* node);
+void ColonyIndexGapChanged(colonyNode* node);
+//------------------------------------------------------------------------------------------
+#endif
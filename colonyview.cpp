@@ -0,0 +1,188 @@
+#include "colonyview.h"
+
+#include <charconv>
+#include <cstring>
+
+//#define DEBUG
+
+/* @brief Copies the buildings of the chunk k of a colony out of its DLL.
+ *
+ * @return The chunk, NULL if none of its blocks holds a building.
+ *
+ * @post The first building of the chunk and the number of its buildings are found through the positional index
+ *       (ColonyIndexFindBlock), the others by walking the DLL from it, so the cost is O(log n) plus the buildings of the chunk.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static shared_ptr<const colonyViewChunk> BuildChunk(const colonyState& state, long long k) {
+
+    long long first = k * COLONY_VIEW_CHUNK + 1, end = first + COLONY_VIEW_CHUNK;
+    long long block = 0;
+
+    colonyNode* node = ColonyIndexFindBlock(state.index, first, block);
+    if (node == NULL || block >= end) return NULL;
+
+    // The buildings of the chunk are the ones before the first building past it, minus the ones before this one
+    long long next = 0;
+    colonyNode* after = ColonyIndexFindBlock(state.index, end, next);
+    long long count = (after != NULL ? ColonyIndexBuildingsBefore(after) : state.index.root->nodeCount) - ColonyIndexBuildingsBefore(node);
+
+    shared_ptr<colonyViewChunk> chunk = make_shared<colonyViewChunk>();
+    chunk->runs.reserve(count);
+    long long last = first - 1; // block of the building before, or the one before the chunk
+
+    while (node != NULL && block < end) {
+        chunk->runs.push_back(colonyRun{(int)(block - last - 1), node->buildType});
+        last = block;
+
+        node = node->next;
+        if (node != NULL) block += node->emptyBlocks2TheLeft + 1;
+    }
+
+    chunk->blocks = last - first + 1;
+    return chunk;
+}
+
+
+
+
+/* @brief Makes a new view of the colony and the stock of a state the current one.
+ *
+ * @param "state" [in][out] The colony, read on the calling thread (the one that owns it). Its changed blocks are
+ *                          forgotten once they are in the view.
+ *
+ * @param "publisher" [in][out] Receives the view, with the next version number.
+ *
+ * @post The first view of a state (or the first one to another publisher) copies every chunk. A later one takes the
+ *       chunks of the previous view and only rebuilds those covering the blocks changed since, plus the ones where the
+ *       length of the colony moved. Shared chunks are never changed, the previous view stays valid for the readers still
+ *       holding it. The stock is copied whole, it is one entry per resource.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ColonyPublish(colonyState& state, colonyPublisher& publisher) {
+
+    shared_ptr<colonyView> view = make_shared<colonyView>();
+
+    view->blocks = ColonyIndexTotalEmptyBlocks(state.index) + (state.index.root != NULL ? state.index.root->nodeCount : 0);
+
+    long long chunks = (view->blocks + COLONY_VIEW_CHUNK - 1) / COLONY_VIEW_CHUNK;
+    view->chunks.resize(chunks);
+
+    // Only this thread stores to current, the load just reads back its own last store
+    shared_ptr<const colonyView> last = atomic_load_explicit(&publisher.current, memory_order_acquire);
+    vector<bool> rebuild(chunks, true);
+
+    if (last != NULL && state.published.publisher == &publisher) {
+
+        long long kept = min(chunks, (long long)last->chunks.size());
+        for (long long k = 0; k < kept; k++) {
+            view->chunks[k] = last->chunks[k];
+            rebuild[k] = false;
+        }
+
+        vector<pair<long long, long long>>& dirty = state.published.dirty;
+        if (view->blocks != last->blocks) dirty.push_back(make_pair(min(view->blocks, last->blocks) + 1, max(view->blocks, last->blocks) + 1));
+
+        // A range past the new end still changes the last chunk if that chunk is kept, so it is clipped by chunk
+        for (const pair<long long, long long>& range : dirty) {
+            long long end = min((range.second - 2) / COLONY_VIEW_CHUNK + 1, chunks);
+            for (long long k = (range.first - 1) / COLONY_VIEW_CHUNK; k < end; k++) {
+                rebuild[k] = true;
+            }
+        }
+    }
+
+    for (long long k = 0; k < chunks; k++) {
+        if (rebuild[k]) view->chunks[k] = BuildChunk(state, k);
+    }
+
+    for (stockNode* ptr = state.stockHead; ptr != NULL; ptr = ptr->next) {
+        view->stock.push_back(make_pair(ptr->resourceName, ptr->resourceQuantity));
+    }
+
+    state.published.publisher = &publisher;
+    state.published.dirty.clear();
+
+    view->version = ++publisher.version;
+    atomic_store_explicit(&publisher.current, shared_ptr<const colonyView>(move(view)), memory_order_release);
+
+    #ifdef DEBUG
+    cout << "DEBUG: COLONY VIEW " << publisher.version << " PUBLISHED, " << chunks << " CHUNKS" << endl;
+    #endif
+}
+
+
+
+
+/* @brief The current view of a colony, safe to call from any thread.
+ *
+ * @return The view, NULL if nothing has been published yet. It stays valid (and unchanged) while it is held.
+ *
+ * @note The shared_ptr atomic free functions are used rather than atomic<shared_ptr>: the load of the latter in
+ *       libstdc++ 12 lets go of its lock bit with a relaxed store, which does not order the pointer read against the
+ *       next store on weakly ordered machines (ThreadSanitizer reports it). The free functions hold a lock from a small
+ *       pool for the pointer copy only, a reader still never waits for a change of the DLLs.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+shared_ptr<const colonyView> ColonyViewAcquire(const colonyPublisher& publisher) {
+
+    return atomic_load_explicit(&publisher.current, memory_order_acquire);
+}
+
+
+
+
+/* @brief Characters RenderViewColony writes: the colony with its inner empty blocks, as PrintColonyWithInnerEmptyBlocks.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+size_t ViewColonyLength(const colonyView& view) {
+
+    return view.blocks;
+}
+
+char* RenderViewColony(const colonyView& view, char* out) {
+
+    for (size_t k = 0; k < view.chunks.size(); k++) {
+
+        // Every chunk but the last spans COLONY_VIEW_CHUNK blocks, the empty ones after its last building included
+        long long length = k + 1 < view.chunks.size() ? COLONY_VIEW_CHUNK : view.blocks - (long long)k * COLONY_VIEW_CHUNK;
+        long long written = 0;
+
+        if (view.chunks[k] != NULL) {
+            for (const colonyRun& run : view.chunks[k]->runs) {
+                memset(out, '-', run.emptyBlocks2TheLeft);
+                out += run.emptyBlocks2TheLeft;
+                *out++ = run.buildType;
+            }
+            written = view.chunks[k]->blocks;
+        }
+
+        memset(out, '-', length - written);
+        out += length - written;
+    }
+    return out;
+}
+
+
+
+
+/* @brief Characters RenderViewStock writes: one "name(quantity)" line per resource, as RenderStock.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+size_t ViewStockLength(const colonyView& view) {
+
+    size_t length = 0;
+    char digits[24];
+
+    for (const pair<string, int>& resource : view.stock) {
+        length += resource.first.size() + 3 + (to_chars(digits, digits + 24, resource.second).ptr - digits);
+    }
+    return length;
+}
+
+char* RenderViewStock(const colonyView& view, char* out) {
+
+    for (const pair<string, int>& resource : view.stock) {
+        memcpy(out, resource.first.data(), resource.first.size());
+        out += resource.first.size();
+        *out++ = '(';
+        out = to_chars(out, out + 24, resource.second).ptr;
+        *out++ = ')';
+        *out++ = '\n';
+    }
+    return out;
+}
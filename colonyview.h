@@ -0,0 +1,77 @@
+// Published read-only versions of a colony, queried from any thread while the owning thread keeps changing the DLLs
+
+#ifndef _COLONYVIEW_
+#define _COLONYVIEW_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "colony.h"
+
+using namespace std;
+
+// The DLLs themselves stay single threaded: only the thread that owns a colonyState changes or walks them. After a
+// change that thread copies what the queries need into a new colonyView and publishes it with one atomic store of a
+// shared_ptr (read-copy-update). A reader takes the current view with one atomic load and keeps it as long as it likes,
+// a view is never changed after it is published and is freed when its last reader lets go of it. Readers never wait
+// for the writer and never see a list in the middle of a change, they may see the version before it.
+//
+// The buildings of a view are held in copy-on-write chunks of COLONY_VIEW_CHUNK blocks. A new view shares every chunk
+// of the previous one that no change since has touched (colonyViewChanges) and only rebuilds the others, so publishing
+// after a change costs the buildings of the chunks it touched plus one shared_ptr copy per chunk, not a copy of the
+// whole colony.
+//------------------------------------------------------------------------------------------
+#define COLONY_VIEW_CHUNK 4096      // blocks per chunk of a view
+//
+// Struct definitions
+//------------------------------------------------------------------------------------------
+// One building of a view, as in colonyNode
+struct colonyRun{
+
+    int emptyBlocks2TheLeft;
+    char buildType;
+};
+
+// The buildings of the blocks [k * COLONY_VIEW_CHUNK + 1, (k + 1) * COLONY_VIEW_CHUNK] of a colony, the chunk k of a view.
+// The empty blocks left of the first run are counted from the start of the chunk, not from the building before it.
+struct colonyViewChunk{
+
+    vector<colonyRun> runs;             // the buildings, in the order of the colony DLL
+    long long blocks;                   // blocks from the start of the chunk up to and including its last building
+
+    colonyViewChunk() : blocks(0) {}
+};
+
+struct colonyView{
+
+    long long version;                  // 1 for the first publication of a colony, one more for every later one
+    long long blocks;                   // length of the colony with its inner empty blocks
+    vector<shared_ptr<const colonyViewChunk>> chunks;   // chunk k as above, NULL if it holds no building, the last
+                                                        // one ends with the last building of the colony
+    vector<pair<string, int>> stock;    // resource name and quantity, in the order of the stock DLL
+
+    colonyView() : version(0), blocks(0) {}
+};
+
+// Where the views of one colony are published. ColonyPublish is called by the owning thread only.
+struct colonyPublisher{
+
+    shared_ptr<const colonyView> current;           // NULL until the first ColonyPublish, read and written with
+                                                    // atomic_load / atomic_store only (see ColonyViewAcquire)
+    long long version;                              // version of the last publication
+
+    colonyPublisher() : version(0) {}
+};
+//------------------------------------------------------------------------------------------
+//
+// Function prototypes
+//------------------------------------------------------------------------------------------
+void ColonyPublish(colonyState& state, colonyPublisher& publisher);
+shared_ptr<const colonyView> ColonyViewAcquire(const colonyPublisher& publisher);
+size_t ViewColonyLength(const colonyView& view);
+char* RenderViewColony(const colonyView& view, char* out);
+size_t ViewStockLength(const colonyView& view);
+char* RenderViewStock(const colonyView& view, char* out);
+//------------------------------------------------------------------------------------------
+#endif
@@ -1,41 +1,15 @@
 #include "functions.h"
+#include "render.h"
+#include "colonyindex.h"
 
-//#define DEBUG
-
-/* @brief Universal file openner with built-in prompting
- *
- * @param "file" [in][out] Ifstream object which the function will return
- *
- * @param "typeOfInput" [in] A string that will be used to decide the type of the txt file (stock/consumption/colony)
- *
- * @Precondition: An ifstream object is not bound to a file and the typeOfInput is determined beforehand
- *
- * @Postcondition: The ifstream object is bound to a file, if the file does not exist or fails to open,
- *                 the user is prompted to enter the filename again until a valid file is provided.
- *
- * @note Debug code included
- * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-void fileOpenner(ifstream &file, string typeOfInput){
-
-    cout << "Please enter the " << typeOfInput <<" file name:" << endl;
-    string filename;
-    cin >> filename;
-    file.open(filename.c_str());
-
-    while( file.fail() ){
-        cout<< "Unable to open the file " << filename << ". ";
-        cout<< "Please enter the correct " << typeOfInput <<" file name:" << endl;
-        cin >> filename;
-        file.open(filename.c_str());
-    }
-
-    #ifdef DEBUG
-    cout << "DEBUG: " << typeOfInput << " FILE HAS BEEN SUCCESSFULLY OPENNED !" << endl;
-    #endif
-}
-
+#include <algorithm>
+#include <cstring>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
+//#define DEBUG
 
 /* @brief Loads stock data from a text file into a DLL and updates the head and tail pointers.
  *
@@ -56,6 +30,8 @@ stockNode* StockLoader(ifstream &file, stockNode*& head,stockNode*& tail) {
     string line;
     while (getline(file, line)) {
 
+        if (!line.empty() && line[0] == '#') continue; // "#trusted <checksum>" line of a file written by ColonyStateSaveTrusted
+
         stringstream ss(line);
         string name;
         int quantity;
@@ -140,13 +116,15 @@ void PrintStockDEBUG(stockNode* head) {
  *
  * @param "quantities" [in] Vector containing quantities of resources consumed by the building which is a data field of the consumpNode.
  *
+ * @param "table" [in][out] Optional recipe table kept in sync with the DLL, the first node of a buildType owns its slot.
+ *
  * @pre The consumption DLL is either empty or already populated, pointers are initialized.
  *
  * @post A new node with the specified building type and quantity vector is appended to the end of the DLL. The head and tail pointers are updated accordingly.
  *
  * @see ConsumptionLoader
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-void ConsumptionAddToEnd(consumpNode*& head, consumpNode*& tail, char BuildingType, vector<int> quantities){
+void ConsumptionAddToEnd(consumpNode*& head, consumpNode*& tail, char BuildingType, vector<int> quantities, consumpTable* table){
 
     if (tail == NULL){
 
@@ -159,6 +137,11 @@ void ConsumptionAddToEnd(consumpNode*& head, consumpNode*& tail, char BuildingTy
         tail->next = ptr;
         tail = ptr;
     }
+
+    // A linear search would stop at the first match, so later duplicates must not steal the slot
+    if (table != NULL && table->recipe[(unsigned char)BuildingType] == NULL) {
+        table->recipe[(unsigned char)BuildingType] = tail;
+    }
 }
 
 
@@ -172,11 +155,13 @@ void ConsumptionAddToEnd(consumpNode*& head, consumpNode*& tail, char BuildingTy
  *
  * @param "tail" [in][out] Reference to the tail pointer of the consumption DLL.
  *
+ * @param "table" [in][out] Recipe table that gets filled alongside the DLL.
+ *
  * @pre Ifstream object is ready to be used, pointers are present and initalized.
  *
  * @post Creates a consumption DLL based on the contents of the consumption file. Re-directs the head & tail pointers accordingly.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-consumpNode* ConsumptionLoader(ifstream&file, consumpNode*& head, consumpNode*& tail){
+consumpNode* ConsumptionLoader(ifstream&file, consumpNode*& head, consumpNode*& tail, consumpTable& table){
 
     string line;
     while(getline(file,line)){
@@ -194,7 +179,7 @@ consumpNode* ConsumptionLoader(ifstream&file, consumpNode*& head, consumpNode*&
             V.push_back(quantity);
         }
 
-        ConsumptionAddToEnd(head, tail, building, V); // newly formed node gets pushed back into the consumption DLL.
+        ConsumptionAddToEnd(head, tail, building, V, &table); // newly formed node gets pushed back into the consumption DLL.
     }
     return head;
 }
@@ -202,6 +187,43 @@ consumpNode* ConsumptionLoader(ifstream&file, consumpNode*& head, consumpNode*&
 
 
 
+/* @brief (Re)builds the recipe table from an existing consumption DLL.
+ *
+ * @param "head" [in] Pointer to the head of the consumption DLL.
+ *
+ * @param "table" [out] Recipe table, every slot is reset before filling.
+ *
+ * @post table.recipe[c] points to the first node whose buildType is c, NULL if there is none.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ConsumptionIndexBuild(consumpNode* head, consumpTable& table){
+
+    table = consumpTable();
+
+    for (consumpNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+        if (table.recipe[(unsigned char)ptr->buildType] == NULL) {
+            table.recipe[(unsigned char)ptr->buildType] = ptr;
+        }
+    }
+}
+
+
+
+
+/* @brief O(1) replacement for the linear search of the consumption DLL by buildType.
+ *
+ * @param "table" [in] Recipe table filled by ConsumptionLoader or ConsumptionIndexBuild.
+ *
+ * @param "buildType" [in] The building type to look up.
+ *
+ * @post Returns the corresponding consumption node, NULL if the building type has no recipe.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+consumpNode* FindConsumption(const consumpTable& table, char buildType){
+    return table.recipe[(unsigned char)buildType];
+}
+
+
+
+
 /* @brief Prints the consumption DLL to console with debugging in mind
  *
  * @param "head" [in] Reference to the head pointer of the consumption DLL.
@@ -265,8 +287,129 @@ void ColonyAddToEnd(colonyNode*& head, colonyNode*& tail, char BuildingType, int
 
 
 
+/* @brief Skips a run of dashes.
+ *
+ * @return Pointer to the first non dash character in [p, end), end if there is none.
+ *
+ * @note 16 characters are compared at once with SSE2 where available.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static const char* SkipDashes(const char* p, const char* end) {
+
+#if defined(__SSE2__)
+    const __m128i dash = _mm_set1_epi8('-');
+    while (end - p >= 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), dash));
+        if (mask != 0xFFFF) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 16;
+    }
+#endif
+
+    while (p < end && *p == '-') {
+        p++;
+    }
+    return p;
+}
+
+
+
+
+/* @brief Parses a chunk of colony text into the colony DLL, reserving the resources of every building on the way.
+ *
+ * @param "p" / "end" [in] The chunk, a building never spans two chunks since it is a single character.
+ *
+ * @param "emptyBlocks" [in][out] Dashes seen since the last building, carried across chunks.
+ *
+ * @param "shortNode" [out] Set to the insufficient stock node when a building can not be afforded.
+ *
+ * @return NULL if the whole chunk has been consumed, otherwise a pointer to the offending building character
+ *         (shortNode != NULL: insufficient resources, shortNode == NULL: building type without recipe).
+ *
+ * @note Line breaks are not blocks and are skipped, so a colony file may end with a newline.
+ *
+ * @see ColonyLoader
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+const char* ColonyParseBlock(const char* p, const char* end, int& emptyBlocks, colonyNode*& head, colonyNode*& tail, stockNode* stockHead, const consumpTable& table, stockNode*& shortNode) {
+
+    while (p < end) {
+
+        const char* runEnd = SkipDashes(p, end);
+        emptyBlocks += runEnd - p;
+        p = runEnd;
+
+        if (p == end) break;
+
+        char c = *p;
+        if (c == '\n' || c == '\r') {
+            p++;
+            continue;
+        }
+
+        //Looking up the corresponding consumption node from the recipe table
+        consumpNode* consumpPtr = FindConsumption(table, c);
+        if (consumpPtr == NULL) {
+            shortNode = NULL;
+            return p;
+        }
+
+        //consumption node is found, now checking for the resource sufficency and deducting in the same walk over the stock
+        if (!ReserveResources(stockHead, consumpPtr->consumpQtys, shortNode)) {
+            return p;
+        }
+
+        ColonyAddToEnd(head, tail, c, emptyBlocks); //finalization of the current checked element
+
+        #ifdef DEBUG
+        cout << "DEBUG: NEW NODE ADDED TO COLONY DLL ! NAME: " << c << " " <<"EMPTYBLOCKS: " << emptyBlocks << endl;
+        #endif
+
+        emptyBlocks = 0;  // Resetting the empty blocks variable for the use of other nodes.
+        p++;
+    }
+
+    return NULL;
+}
+
+
+
+
+/* @brief Trusted counterpart of ColonyParseBlock, only rebuilds the colony structure.
+ *
+ * @param "block" [in][out] Block of the last building parsed so far, 0 before the first one.
+ *
+ * @param "hash" [in][out] Running sum of the colony checksum, every building adds its ColonyBlockTerm while its node is hot.
+ *
+ * @pre The stock already has the balances after every building of the chunk has been paid for and every building
+ *      type has a recipe (a colony file written by ColonyStateSaveTrusted, the caller compares the checksum).
+ *
+ * @see ColonyParseBlock
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ColonyParseBlockTrusted(const char* p, const char* end, int& emptyBlocks, colonyNode*& head, colonyNode*& tail, long long& block, unsigned long long& hash) {
+
+    while (p < end) {
+
+        const char* runEnd = SkipDashes(p, end);
+        emptyBlocks += runEnd - p;
+        p = runEnd;
+
+        if (p == end) break;
+
+        char c = *p++;
+        if (c == '\n' || c == '\r') continue;
+
+        ColonyAddToEnd(head, tail, c, emptyBlocks);
+        block += emptyBlocks + 1;
+        hash += ColonyBlockTerm(block, c);
+        emptyBlocks = 0;
+    }
+}
+
+
+
+
 /* @brief Loads colony data from a file into a DLL, checks for sufficent resources, if sufficent, updates stock quantities based on consumption corresponding consumption data.
- *        else, exits the program while closing the files and deleting the allocated memory.
+ *        else, stops and reports what went wrong.
  *
  * @param "head" [in][out] Reference to the head pointer of the original colony DLL.
  *
@@ -274,77 +417,86 @@ void ColonyAddToEnd(colonyNode*& head, colonyNode*& tail, char BuildingType, int
  *
  * @param "stockHead" [in][out] Pointer to the head of the original stock DLL.
  *
- * @param "consumpHead" [in] Pointer to the head of the original consumption DLL.
+ * @param "table" [in] Recipe table of the consumption DLL, used for the per building lookups.
  *
- * @param "fileSTOCK" [in] Reference to an ifstream object containing stock data.
+ * @param "fileCOLONY" [in] Reference to an ifstream object containing colony data.
  *
- * @param "fileCONSUMPTION" [in] Reference to an ifstream object containing consumption data.
+ * @param "stats" [out] Optional, receives the amount of bytes read and the time spent (throughput in MB/s).
  *
- * @param "fileCOLONY" [in] Reference to an ifstream object containing colony data.
+ * @param "trustedHash" [in][out] Optional. The stock already reflects the colony (ColonyStateSaveTrusted): the recipe
+ *                                 lookups and stock deductions are skipped, only the structure is rebuilt and the
+ *                                 buildings are added into this sum (ColonyBlockTerm) for the caller to compare.
  *
  * @pre The file objects is successfully opened and ready for reading. The head and tail pointers for the colony, stock, and consumption DLLs should either point to valid nodes or be null.
  *
  * @post Creates a colony DLL based on the contents of the colony file. Updates the stock quantities based on the consumption of resources for each building in the colony.
- *       If there are insufficient resources, the program will terminate after clearing the memory in addition to informing the user about the insufficient resource.
+ *       Returns COLONY_OK, or COLONY_INSUFFICIENT (with the building type and the resource) / COLONY_UNKNOWN_TYPE (with the type).
+ *       On failure nothing is printed, the colony built so far is deleted and the stock keeps the deductions made so far,
+ *       so the caller is expected to discard the stock as well (the CLI informs the user and terminates).
  *       The head & tail pointers of the colony DLL are re-directed accordingly.
+ *       The file is read in COLONY_BLOCK_SIZE chunks, runs of dashes are skipped in bulk and only buildings create nodes.
  *
  * @note Debug code included
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-colonyNode* ColonyLoader(colonyNode*& head, colonyNode*& tail, stockNode* stockHead, consumpNode* consumpHead, ifstream &fileSTOCK, ifstream &fileCONSUMPTION, ifstream &fileCOLONY){
+colonyStatus ColonyLoader(colonyNode*& head, colonyNode*& tail, stockNode* stockHead, const consumpTable& table, ifstream &fileCOLONY, colonyLoadStats* stats, unsigned long long* trustedHash){
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
-    char c;
+    vector<char> buffer(COLONY_BLOCK_SIZE);
 
     int emptyBlocks = 0;
+    long long bytes = 0, block = 0;
 
-    while(fileCOLONY.get(c)){
+    while (fileCOLONY.read(buffer.data(), buffer.size()) || fileCOLONY.gcount() > 0) {
 
-        if (c == '-') {
-            //encountered char is dash, increase counter
-            emptyBlocks++;
-        } else {
+        streamsize got = fileCOLONY.gcount();
+        bytes += got;
 
-            //
-            //Linear searching the consumption DLL to detect the corresponding node
-            consumpNode* consumpPtr = consumpHead;
-            while (consumpPtr->buildType != c) {    //consumpPtr != NULL && ------------------------------
-                consumpPtr = consumpPtr->next;
-            }
+        if (trustedHash != NULL) {
+            ColonyParseBlockTrusted(buffer.data(), buffer.data() + got, emptyBlocks, head, tail, block, *trustedHash);
+            continue;
+        }
 
-            //consumption node is found, now checking for the resource sufficency by iterating the elements of the vector
-            stockNode* stockPtr = stockHead;
-            for (int i = 0; i < consumpPtr->consumpQtys.size(); i++) {
+        stockNode* shortNode = NULL;
+        const char* bad = ColonyParseBlock(buffer.data(), buffer.data() + got, emptyBlocks, head, tail, stockHead, table, shortNode);
 
-                if (stockPtr->resourceQuantity < consumpPtr->consumpQtys[i]) {          //stockPtr == NULL ||    ------------------------
+        if (bad != NULL) {
+            return ColonyLoadFailure(head, tail, bad, shortNode);
+        }
+    }
 
-                    cout << "Insufficient resource " << stockPtr->resourceName << endl;
-                    cout << "Failed to load the colony due to insufficient resources." << endl;
-                    cout << "Clearing the memory and terminating the program." << endl;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-                    fileSTOCK.close();
-                    fileCONSUMPTION.close();
-                    fileCOLONY.close();
+    if (stats != NULL) {
+        stats->bytes = bytes;
+        stats->seconds = seconds;
+    }
 
-                    DeleteAll(stockHead);
-                    DeleteAll(consumpHead);
-                    DeleteAll(head);
+    #ifdef DEBUG
+    cout << "DEBUG: COLONY LOADED, " << bytes << " BYTES, " << (seconds > 0 ? bytes / 1e6 / seconds : 0) << " MB/s" << endl;
+    #endif
 
-                    exit(1);
-                }
-                stockPtr->resourceQuantity = stockPtr->resourceQuantity - consumpPtr->consumpQtys[i]; //deduction
-                stockPtr = stockPtr->next; //advance stock pointer to right
-            }
+    return colonyStatus(COLONY_OK);
+}
 
-            ColonyAddToEnd(head, tail, c, emptyBlocks); //finalization of the current checked element
 
-            #ifdef DEBUG
-            cout << "DEBUG: NEW NODE ADDED TO COLONY DLL ! NAME: " << c << " " <<"EMPTYBLOCKS: " << emptyBlocks << endl;
-            #endif
 
-            emptyBlocks = 0;  // Resetting the empty blocks variable for the use of other nodes.
-        }
-    }
 
-    return head; // returns the freshly created DLL's head
+/* @brief Common failure path of ColonyLoader / ColonyLoaderMapped, deletes the partial colony and describes the failure.
+ *
+ * @param "bad" [in] The character ColonyParseBlock stopped at.
+ *
+ * @param "shortNode" [in] The stock node that ran short, NULL if the building type is unknown.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyLoadFailure(colonyNode*& head, colonyNode*& tail, const char* bad, stockNode* shortNode) {
+
+    DeleteAll(head);
+    tail = NULL;
+
+    if (shortNode != NULL) {
+        return colonyStatus(COLONY_INSUFFICIENT, *bad, shortNode->resourceName);
+    }
+    return colonyStatus(COLONY_UNKNOWN_TYPE, *bad);
 }
 
 
@@ -381,36 +533,6 @@ void PrintColonyDEBUG(colonyNode* head) {
 
 
 
-/* @brief Deletes all nodes in a given doubly linked list (DLL) and deallocates memory.
- *
- * @tparam Node A template parameter representing the type of node in the DLL. (stock/consumption/colony)
- *
- * @param "head" [in] Reference to the head pointer of the entered DLL.
- *
- * @pre The head pointer points to the first node of the DLL or be null if the list is empty.
- *
- * @post All nodes in the DLL are deleted and their memory is deallocated. The head pointer is set to NULL
- *
- * @note Debug code included
- *
- * @note Dersi 3. alışım, templated kullanmamış olup 3 ayrı fonk yazsaydım sağlam günaha girmiş olurdum
- * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-template <typename Node>
-void DeleteAll(Node*& head) {
-    #ifdef DEBUG
-    cout << "DEBUG: DELETING THE LINKED LIST" << endl;
-    #endif
-
-    while(head != NULL){
-        Node* temp = head;
-        head = head->next;
-        delete temp;
-    }
-}
-
-
-
-
 /* @brief Prints the contents of the stock DLL to the console.
  *
  * @param "head" [in] Pointer to the head node of the stock DLL.
@@ -423,25 +545,19 @@ void DeleteAll(Node*& head) {
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 void PrintStock(stockNode* head) {
 
-    stockNode* temp = head;
-
-    if (temp == NULL){
-        cout << "The list is empty !" << endl;
-    } else {
-
-        cout << "Stock DLL:" << endl;
+    if (head == NULL){
+        EmitBuffer("The list is empty !\n");
+        return;
+    }
 
-        while (temp != NULL) {
+    const char* header = "Stock DLL:\n";
 
-            string tempStr = temp->resourceName;
-            int tempInt = temp->resourceQuantity;
+    string buffer(strlen(header) + StockLength(head), '\0');
 
-            //formatting output
-            cout << tempStr << "(" << tempInt << ")" << endl;
+    char* out = RenderText(header, &buffer[0]);
+    RenderStock(head, out);
 
-            temp = temp->next;
-        }
-    }
+    EmitBuffer(buffer);
 }
 
 
@@ -455,31 +571,23 @@ void PrintStock(stockNode* head) {
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 void PrintColony(colonyNode* head){
 
-    colonyNode* temp = head;
-    colonyNode* temp2 = head;
-
-    cout << "Colony DLL:" << endl;
+    const char* header = "Colony DLL:\n";
 
-    if (temp == NULL){
-        cout << "The list is empty !" << endl;
-    } else {
-
-        string tempStr = "";
-        while(temp2 != NULL){
-            tempStr = tempStr + temp2->buildType;
-            temp2 = temp2->next;
-        }
-
-        cout << tempStr << endl;
+    if (head == NULL){
+        EmitBuffer(string(header) + "The list is empty !\n");
+        return;
+    }
 
-        while(temp != NULL){
+    // "ZeGVKM\n(4)Z(0)e(1)G(1)V(0)K(0)M\n", sized exactly before anything is written
+    string buffer(strlen(header) + BuildingTypesLength(head) + 1 + EncodedColonyLength(head) + 1, '\0');
 
-            cout << "(" << temp->emptyBlocks2TheLeft << ")" << temp->buildType;
-            temp = temp->next;
+    char* out = RenderText(header, &buffer[0]);
+    out = RenderBuildingTypes(head, out);
+    *out++ = '\n';
+    out = RenderEncodedColony(head, out);
+    *out++ = '\n';
 
-        }
-        cout << endl;
-    }
+    EmitBuffer(buffer);
 }
 
 
@@ -487,18 +595,31 @@ void PrintColony(colonyNode* head){
 
 /* @brief Prints the colony DLL in the requested format in THE2 (reverse)
  *
- * @param "head" [in] Pointer to the head of the original colony DLL.
+ * @param "tail" [in] Pointer to the tail of the original colony DLL.
+ *
+ * @post The building types are written from the tail towards the head by following the prev links into a buffer that is
+ *       sized by a counting pass beforehand, then emitted with a single write. No recursion, so the stack depth does not
+ *       depend on the colony size, and every character is copied once.
  *
  * @note represents button 4 in CLI menu
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-void PrintColonyReverse(colonyNode* node, string& tempStr) {
-    if (node == NULL) {
-        return;
+void PrintColonyReverse(colonyNode* tail) {
+
+    size_t count = 0;
+    for (colonyNode* ptr = tail; ptr != NULL; ptr = ptr->prev) {
+        count++;
     }
-    PrintColonyReverse(node->next,tempStr);
 
-    tempStr = tempStr + node->buildType;
+    const char* header = "(Reverse) Colony DLL:\n";
+
+    string buffer(strlen(header) + count + 1, '\n'); // the last slot stays as the line break
+
+    char* out = RenderText(header, &buffer[0]);
+    for (colonyNode* ptr = tail; ptr != NULL; ptr = ptr->prev) {
+        *out++ = ptr->buildType;
+    }
 
+    EmitBuffer(buffer);
 }
 
 
@@ -512,23 +633,14 @@ void PrintColonyReverse(colonyNode* node, string& tempStr) {
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 void PrintColonyWithInnerEmptyBlocks(colonyNode* head){
 
-    string tempStr = "";
-
-    colonyNode* ptr = head;
-
-    cout << "Colony DLL:" << endl;
+    const char* header = "Colony DLL:\n";
 
-    while (ptr != NULL){
+    string buffer(strlen(header) + DecodedColonyLength(head) + 1, '\n');
 
-        for (int i = 0; i < ptr->emptyBlocks2TheLeft; i++){
-            tempStr += '-';
-        }
+    char* out = RenderText(header, &buffer[0]);
+    RenderDecodedColony(head, out);
 
-        tempStr += ptr->buildType;
-        ptr = ptr->next;
-    }
-
-    cout << tempStr << endl;
+    EmitBuffer(buffer);
 }
 
 
@@ -536,16 +648,12 @@ void PrintColonyWithInnerEmptyBlocks(colonyNode* head){
 
 /* @brief reverses a given string
  *
- * @param "str" [in][out] reference to the given string
+ * @param "str" [in][out] reference to the given string, reversed in place
  *
  * @note This is a helper function for option 6
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 void reverseString(string& str){
-    string temp;
-    for (int i = str.length() - 1; i >= 0; i--){
-        temp += str[i];
-    }
-    str = temp;
+    reverse(str.begin(), str.end());
 }
 
 
@@ -559,268 +667,519 @@ void reverseString(string& str){
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 void PrintColonyWithInnerEmptyBlocksREVERSE(colonyNode* head){
 
-    string tempStr = "";
-
-    colonyNode* ptr = head;
-
-    cout << "(Reverse) Colony DLL:" << endl;
+    const char* header = "(Reverse) Colony DLL:\n";
+    size_t headerLength = strlen(header);
+    size_t length = DecodedColonyLength(head);
 
-    while (ptr != NULL){
+    string buffer(headerLength + length + 1, '\n');
 
-        for (int i = 0; i < ptr->emptyBlocks2TheLeft; i++){
-            tempStr += '-';
-        }
-
-        tempStr += ptr->buildType;
-        ptr = ptr->next;
-    }
+    char* out = RenderText(header, &buffer[0]);
+    RenderDecodedColony(head, out);
+    reverse(out, out + length); // in place, no second string
 
-    reverseString(tempStr);
-
-    cout << tempStr << endl;
+    EmitBuffer(buffer);
 }
 
 
 
 
-/* @brief Deletes a specified building type from the colony doubly linked list (DLL). If the building type is found,
- *        it's first occurrance is removed from the colony DLL, and the resources associated with it are added back to the stock.
- *        If the building type is not found, the user will be displayed with an appropriate message.
- *
- * @param "colonyHead" [in][out] Reference to the head pointer of the colony DLL. The function may modify the DLL, potentially updating the head pointer if the first node is deleted.
- *
- * @param "buildingType" [in] The type of building to be deleted from the colony.
+/* @brief Removes the first occurrance of a building type from the colony and gives its resources back to the stock, without any console I/O.
  *
- * @param "consumpHead" [in] Reference to the head pointer of the consumption DLL. Used to find the resource consumption of the building type to be deleted.
+ * @param "colIndex" [in][out] Optional positional index of the colony, kept up to date. With it the first occurrance is found in O(log n).
  *
- * @param "stockHead" [in][out] Reference to the head pointer of the stock DLL. The function updates the stock based on the resources associated with the deleted building.
+ * @return COLONY_OK, or COLONY_NOT_FOUND if the colony has no building of that type (nothing is changed).
  *
- * @note represents button 2 in CLI menu
+ * @see DeleteBuildingFromColony (cli.cpp)
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-void DeleteBuildingFromColony(colonyNode*& colonyHead, char buildingType, consumpNode* consumpHead, stockNode* stockHead) {
+colonyResult DestroyBuilding(colonyNode*& colonyHead, colonyNode*& colonyTail, char buildingType, const consumpTable& table, stockNode* stockHead, colonyIndex* colIndex) {
 
     colonyNode* temp = colonyHead;
-    colonyNode* prev = NULL;
 
-    // Search for the first occurrance of user given buildingType in colony DLL by linear searching the colony DLL
-    while (temp != NULL && temp->buildType != buildingType) {
-        prev = temp;
-        temp = temp->next;
+    if (colIndex != NULL) {
+        // Search for the first occurrance through the type masks of the index
+        temp = ColonyIndexFindFirst(*colIndex, buildingType);
+    } else {
+        // Search for the first occurrance of user given buildingType in colony DLL by linear searching the colony DLL
+        while (temp != NULL && temp->buildType != buildingType) {
+            temp = temp->next;
+        }
     }
 
-    // If the node is not found in the DLL
     if (temp == NULL) {
-        cout << "Building of type " << buildingType << " not found in the colony." << endl;
-
-        //Clearing input buffer so that menu inputs wont interfere with last failed menu option case
-        cin.clear();
-        cin.ignore(9999999, '\n');
-        return; // return to asking menu options
+        return COLONY_NOT_FOUND;
     }
 
     // Find the building type in the consumption DLL
-    consumpNode* consumpPtr = consumpHead;
-    while (consumpPtr != NULL && consumpPtr->buildType != buildingType) {
-        consumpPtr = consumpPtr->next;
-    }
+    consumpNode* consumpPtr = FindConsumption(table, buildingType);
 
-    // If the building type is found in the consumption DLL:
+    // If the building type is found in the consumption DLL, reclaim the resources
     if (consumpPtr != NULL) {
-        stockNode* stockPtr = stockHead;
-        for (int i = 0; i < consumpPtr->consumpQtys.size(); i++) {
+        ReleaseResources(stockHead, consumpPtr->consumpQtys);
+    }
 
-            if (stockPtr != NULL) { // Reclaim the resources
+    ColonyRemoveBuilding(colonyHead, colonyTail, temp, colIndex);
 
-                stockPtr->resourceQuantity += consumpPtr->consumpQtys[i];
+    return COLONY_OK;
+}
 
-                stockPtr = stockPtr->next;
-            }
-        }
+
+
+
+/* @brief Unlinks and frees one building of the colony DLL, its empty blocks and its own block join the gap of its successor.
+ *
+ * @param "node" [in] The building to be removed, a node of the colony DLL.
+ *
+ * @param "colIndex" [in][out] Optional positional index of the colony, kept up to date.
+ *
+ * @post The stock is not touched. If node was the tail, the dashes to its left are trailing now and get dropped.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ColonyRemoveBuilding(colonyNode*& colonyHead, colonyNode*& colonyTail, colonyNode* node, colonyIndex* colIndex) {
+
+    colonyNode* prev = node->prev;
+
+    if (colIndex != NULL) {
+        ColonyIndexRemove(*colIndex, node);
+    }
+
+    // If the node to be deleted is the last node, its predecessor becomes the tail
+    if (node == colonyTail) {
+        colonyTail = prev;
     }
 
     // If the node to be deleted is the first node
     if (prev == NULL) {
-        colonyHead = temp->next;
+        colonyHead = node->next;
         if (colonyHead != NULL) { // If the list has more than one node:
             colonyHead->prev = NULL;
-            colonyHead->emptyBlocks2TheLeft += (1 + temp->emptyBlocks2TheLeft);
+            colonyHead->emptyBlocks2TheLeft += (1 + node->emptyBlocks2TheLeft);
         }
     } else {
 
-        prev->next = temp->next;
+        prev->next = node->next;
 
         // If the node to be deleted is not the last node
-        if (temp->next != NULL) {
-            temp->next->prev = prev;
-            temp->next->emptyBlocks2TheLeft += (1 + temp->emptyBlocks2TheLeft);
+        if (node->next != NULL) {
+            node->next->prev = prev;
+            node->next->emptyBlocks2TheLeft += (1 + node->emptyBlocks2TheLeft);
+        }
+    }
+    // The gap of the deleted building went to its successor
+    if (colIndex != NULL && node->next != NULL) {
+        ColonyIndexGapChanged(node->next);
+    }
+    delete node;
+}
+
+
+
+
+/* @brief One pass of a bulk removal: walks the colony DLL from ptr and removes what select picks, the gaps of removed
+ *        buildings (and their own blocks) are carried to the next building that stays.
+ *
+ * @tparam Select Callable on a node: 1 removes it, 0 keeps it, -1 ends the pass before it. Sees the node before its gap changes.
+ *
+ * @param "rebuild" [in] The index (if any) is rebuilt afterwards by the caller, so it is not updated node by node.
+ *
+ * @param "counts" [in][out] Removed buildings of each type are added to it.
+ *
+ * @return Number of removed buildings.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename Select>
+static long long RemovePass(colonyNode*& head, colonyNode*& tail, colonyNode* ptr, Select select, long long* counts, colonyIndex* colIndex, bool rebuild) {
+
+    long long removed = 0;
+    long long carry = 0; // blocks freed since the last building that stays
+
+    while (ptr != NULL) {
+
+        int pick = select(ptr);
+        if (pick < 0) break;
+
+        colonyNode* next = ptr->next;
+
+        if (pick == 0) {
+            if (carry != 0) {
+                ptr->emptyBlocks2TheLeft += carry;
+                if (colIndex != NULL && !rebuild) ColonyIndexGapChanged(ptr);
+                carry = 0;
+            }
+            ptr = next;
+            continue;
         }
+
+        if (colIndex != NULL && !rebuild) ColonyIndexRemove(*colIndex, ptr);
+
+        carry += ptr->emptyBlocks2TheLeft + 1;
+        counts[(unsigned char)ptr->buildType]++;
+        removed++;
+
+        if (ptr->prev != NULL) ptr->prev->next = next; else head = next;
+        if (next != NULL) next->prev = ptr->prev; else tail = ptr->prev;
+
+        delete ptr;
+        ptr = next;
+    }
+
+    // The building the pass stopped at takes what is left, past the tail the blocks are trailing and dropped
+    if (ptr != NULL && carry != 0) {
+        ptr->emptyBlocks2TheLeft += carry;
+        if (colIndex != NULL && !rebuild) ColonyIndexGapChanged(ptr);
     }
-    delete temp;
 
-    cout << "The building of type " << buildingType << " has been deleted from the colony." << endl;
+    return removed;
 }
 
 
 
 
-/* @brief Constructs a new building in the colony based on the user's input for building type and its position with stock and memory management in mind.
+/* @brief Removes the first "limit" buildings of a type from the colony in one pass, without touching the stock.
  *
- * @param "colonyHead" [in][out] Reference to the head pointer of the original colony DLL.
+ * @param "limit" [in] How many to remove at most, LLONG_MAX for all of them.
  *
- * @param "colonyTail" [in][out] Reference to the tail pointer of the original colony DLL.
+ * @param "colIndex" [in][out] Optional positional index of the colony, kept up to date. With it a few buildings of the
+ *                             type are reached by hopping from one to the next through the index, when more than 1/16 of
+ *                             the colony goes the DLL is walked once and the index rebuilt afterwards.
  *
- * @param "consumpHead" [in] Reference to the head pointer of the original consumption DLL.
+ * @return Number of removed buildings.
  *
- * @param "stockHead" [in][out] Reference to the head pointer of the original stock DLL.
+ * @post Same colony as "limit" DestroyBuilding calls, the gaps are coalesced on the way.
  *
- * @note Debug code included
+ * @see ColonyRemoveBuilding
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+long long ColonyRemoveType(colonyNode*& colonyHead, colonyNode*& colonyTail, char buildingType, long long limit, colonyIndex* colIndex) {
+
+    long long removed = 0;
+
+    if (colIndex != NULL) {
+        long long buildings = colIndex->root != NULL ? colIndex->root->nodeCount : 0;
+
+        if (min(limit, colIndex->typeCount[(unsigned char)buildingType]) * 16 <= buildings) {
+
+            colonyNode* node = ColonyIndexFindFirst(*colIndex, buildingType);
+            while (node != NULL && removed < limit) {
+                colonyNode* next = ColonyIndexFindNext(node, buildingType);
+                ColonyRemoveBuilding(colonyHead, colonyTail, node, colIndex);
+                removed++;
+                node = next;
+            }
+            return removed;
+        }
+    }
+
+    long long counts[256] = {0};
+    colonyNode* start = colIndex != NULL ? ColonyIndexFindFirst(*colIndex, buildingType) : colonyHead;
+
+    removed = RemovePass(colonyHead, colonyTail, start, [&](colonyNode* node) {
+        if (counts[(unsigned char)buildingType] == limit) return -1;
+        return node->buildType == buildingType ? 1 : 0;
+    }, counts, colIndex, true);
+
+    if (colIndex != NULL) ColonyIndexBuild(colonyHead, *colIndex);
+
+    return removed;
+}
+
+
+
+
+/* @brief Removes every building in the blocks [first, end) of the colony in one pass, without touching the stock.
+ *
+ * @param "first" / "end" [in] Block range, blocks count every position (empty or not) from 1, as the colony is printed
+ *                             with its inner empty blocks.
+ *
+ * @param "counts" [out] counts[c] receives the number of removed buildings of type c (256 entries, zeroed here).
  *
- * @note represents button 1 in CLI menu
+ * @param "colIndex" [in][out] Optional positional index of the colony, kept up to date. With it the pass starts at the
+ *                             first building of the range.
+ *
+ * @return Number of removed buildings.
+ *
+ * @post The blocks of the range are all empty afterwards, no other building moves.
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-void ConstructNewBuilding(colonyNode*& colonyHead, colonyNode*& colonyTail, consumpNode* consumpHead, stockNode* stockHead) {
+long long ColonyRemoveRange(colonyNode*& colonyHead, colonyNode*& colonyTail, long long first, long long end, long long* counts, colonyIndex* colIndex) {
+
+    for (int c = 0; c < 256; c++) counts[c] = 0;
 
-    // First stage, ask for buildingType
-    char buildingType;
-    cout << "Please enter the building type:" << endl;
-    cin >> buildingType;
+    colonyNode* start = colonyHead;
+    long long block = 0; // block of the building before start
+    bool rebuild = false;
 
+    if (colIndex != NULL) {
+        long long buildings = colIndex->root != NULL ? colIndex->root->nodeCount : 0;
+        rebuild = min(end - first, buildings) * 16 > buildings;
 
-    // Second stage, Validate the building type
-    consumpNode* consumpPtr = consumpHead;
-    while (consumpPtr != NULL && consumpPtr->buildType != buildingType) {
-        consumpPtr = consumpPtr->next;
+        long long position;
+        start = ColonyIndexFindBlock(*colIndex, first, position);
+        if (start != NULL) block = position - start->emptyBlocks2TheLeft - 1;
     }
-    while (consumpPtr == NULL) {
 
-        cout << "Building type " << buildingType << " is not found in the consumption DLL. Please enter a valid building type:" << endl;
-        cin >> buildingType;
+    long long removed = RemovePass(colonyHead, colonyTail, start, [&](colonyNode* node) {
+        block += node->emptyBlocks2TheLeft + 1;
+        if (block >= end) return -1;
+        return block >= first ? 1 : 0;
+    }, counts, colIndex, rebuild);
 
-        consumpPtr = consumpHead;
-        while (consumpPtr != NULL && consumpPtr->buildType != buildingType) {
-            consumpPtr = consumpPtr->next;
-        }
+    if (rebuild) ColonyIndexBuild(colonyHead, *colIndex);
+
+    return removed;
+}
+
+
+
+
+/* @brief Places a building of a type on the index'th empty block of the colony, without any console I/O.
+ *
+ * @param "buildingType" [in] Type of the building to be placed.
+ *
+ * @param "index" [in] 1-based number of the empty block, see ColonyInsertAtEmptyBlock.
+ *
+ * @param "shortNode" [out] On COLONY_INSUFFICIENT, the first stock node that can not cover the recipe.
+ *
+ * @param "colIndex" [in][out] Optional positional index of the colony, kept up to date.
+ *
+ * @return COLONY_OK, COLONY_UNKNOWN_TYPE, COLONY_BAD_INDEX or COLONY_INSUFFICIENT. Nothing is changed unless COLONY_OK is returned.
+ *
+ * @see ConstructNewBuilding (cli.cpp)
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyResult ConstructBuilding(colonyNode*& colonyHead, colonyNode*& colonyTail, const consumpTable& table, stockNode* stockHead, char buildingType, int index, stockNode*& shortNode, colonyIndex* colIndex) {
+
+    consumpNode* consumpPtr = FindConsumption(table, buildingType);
+
+    if (consumpPtr == NULL) {
+        return COLONY_UNKNOWN_TYPE;
+    }
+    if (index < 1) {
+        return COLONY_BAD_INDEX;
+    }
+    if (!ReserveResources(stockHead, consumpPtr->consumpQtys, shortNode)) {
+        return COLONY_INSUFFICIENT;
     }
 
+    ColonyInsertAtEmptyBlock(colonyHead, colonyTail, buildingType, index, colIndex);
+
+    return COLONY_OK;
+}
+
 
-    // Third stage, Check if there are enough resources in the stock
-    stockNode* stockPtr = stockHead;
-    for (int i = 0; i < consumpPtr->consumpQtys.size(); i++) {
-        if (stockPtr->resourceQuantity  <  consumpPtr->consumpQtys[i]) {
 
-            cout << "Insufficient resource " << stockPtr->resourceName << endl;
-            cout << "Failed to add the building due to insufficient resources." << endl;
-            return;
-        } else {
 
+/* @brief Places a building on the index'th empty block of the colony DLL by splitting the gap that owns that block.
+ *
+ * @param "head" [in][out] Reference to the head pointer of the colony DLL.
+ *
+ * @param "tail" [in][out] Reference to the tail pointer of the colony DLL.
+ *
+ * @param "buildingType" [in] Type of the building to be placed.
+ *
+ * @param "index" [in] 1-based number of the empty block (dash) that the building will occupy.
+ *
+ * @param "colIndex" [in][out] Optional positional index of the colony, kept up to date. With it the owning gap is found in O(log n).
+ *
+ * @pre index >= 1, resources of the building are already handled by the caller.
+ *
+ * @post Only the nodes up to the owning gap are visited (O(k)), exactly one colonyNode is allocated and linked in.
+ *       If index is beyond the last dash of the colony, the building is appended after (index - dashes - 1) new empty blocks.
+ *       head & tail stay valid without rescanning. Returns the new node.
+ *
+ *       colony: (2)X(1)Y(3)Z, index 4 -> the 1st dash of Z's gap -> (2)X(1)Y(0)A(2)Z
+ *
+ * @see ConstructNewBuilding (cli.cpp)
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyNode* ColonyInsertAtEmptyBlock(colonyNode*& head, colonyNode*& tail, char buildingType, int index, colonyIndex* colIndex) {
+
+    colonyNode* ptr = head;
+    int remaining = index; // the target is the remaining'th dash counting from the left of ptr's gap
+
+    if (colIndex != NULL) {
+        long long offset;
+        ptr = ColonyIndexFindEmptyBlock(*colIndex, index, offset);
+        remaining = (int)offset;
+    } else {
+        while (ptr != NULL && ptr->emptyBlocks2TheLeft < remaining) {
+            remaining -= ptr->emptyBlocks2TheLeft;
+            ptr = ptr->next;
         }
-        stockPtr = stockPtr->next;
     }
 
+    // Ran past the last building, new dashes are needed on the right end
+    if (ptr == NULL) {
+        ColonyAddToEnd(head, tail, buildingType, remaining - 1);
+        if (colIndex != NULL) ColonyIndexInsertBefore(*colIndex, tail, NULL);
+        return tail;
+    }
 
-    // Fourth stage,  If the sequental execution ever comes to this point it means that the buildingType is present and there are enough resources in stocks
-    // to build 1 piece of the given buildingType. Therefore, Deduce the resources from stock.
-
-    //Reset pointers
-    stockPtr = stockHead;
-    consumpPtr = consumpHead;
+    // Split ptr's gap: (remaining - 1) dashes go to the new node, the chosen dash becomes the building
+    colonyNode* newNode = new colonyNode(buildingType, remaining - 1, ptr, ptr->prev);
+    ptr->emptyBlocks2TheLeft -= remaining;
 
-    //linear search for the corresponding node in consumption DLL
-    while (consumpPtr != NULL && consumpPtr->buildType != buildingType) {
-        consumpPtr = consumpPtr->next;
+    if (ptr->prev != NULL) {
+        ptr->prev->next = newNode;
+    } else {
+        head = newNode;
     }
-    // Deduction happens here
-    for (int i = 0; i < consumpPtr->consumpQtys.size(); i++) {
-        stockPtr->resourceQuantity = stockPtr->resourceQuantity - consumpPtr->consumpQtys[i];
-        stockPtr = stockPtr->next;
+    ptr->prev = newNode;
+
+    if (colIndex != NULL) {
+        ColonyIndexGapChanged(ptr);
+        ColonyIndexInsertBefore(*colIndex, newNode, ptr);
     }
 
+    return newNode;
+}
 
-    //Fifth stage, prompt the user for the index of the first empty block, apply the modifications on a decoded colony, than encode that colony and than re-arrange the original pointers.
-    int index;
-    cout << "Please enter the index of the empty block where you want to construct a building of type " << buildingType << endl;
-    cin >> index;
 
-    //colony: (2)X(1)Y(3)Z (encoded)
-    string COLONYSTRING = decodeColony(colonyHead); // DLL -> character array
-    //COLONYSTRING: --X-Y---Z (decoded)
 
-    /*
-    CONDITION 1, index mevcuttur hazır stringde. (--X-Y---Z ve index 1 bu olur: A-X-Y---Z) EŞİTSE DE BU CONDITION ÇALIŞIR !
-    CONDITION 2, index stringin içinde mevcut degildir, yeni dash eklenip son eklenen dash'ın yerine yerleştirilmesi gerekmektedir yeni Building'in. (--X-Y---Z ve index 8 bu olur: --X-Y---Z-A)
-    */
 
-    // Calculate the dashes present in the decoded colony
-    int dashamount = 0;
-    for (char c : COLONYSTRING){
-        if (c == '-'){
-            dashamount++;
-        }
+/* @brief Places one building of a type on each of a list of empty blocks in a single pass over the colony DLL.
+ *
+ * @param "head" [in][out] Reference to the head pointer of the colony DLL.
+ *
+ * @param "tail" [in][out] Reference to the tail pointer of the colony DLL.
+ *
+ * @param "buildingType" [in] Type of the buildings to be placed.
+ *
+ * @param "blocks" [in] 1-based empty block numbers, strictly increasing and at most INT_MAX, all counted on the colony as
+ *                      it is before the call.
+ *
+ * @param "colIndex" [in][out] Optional positional index of the colony, kept up to date. With it the pass starts at the gap
+ *                             that owns the first block instead of at the head.
+ *
+ * @pre Resources of the buildings are already handled by the caller.
+ *
+ * @post Every gap that owns blocks is split once, from left to right; blocks beyond the last dash are appended after the
+ *       tail. The index is updated node by node when few buildings are placed and rebuilt in one go when they are more
+ *       than 1/16 of the colony.
+ *
+ *       colony: (2)X(3)Z, blocks 1 3 5 -> (0)A(1)X(0)A(1)A(0)Z
+ *
+ * @see ColonyInsertAtEmptyBlock
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ColonyInsertAtEmptyBlocks(colonyNode*& head, colonyNode*& tail, char buildingType, const vector<long long>& blocks, colonyIndex* colIndex) {
+
+    if (blocks.empty()) return;
+
+    colonyNode* ptr = head;
+    long long base = 0;     // empty blocks left of ptr's gap
+    size_t k = 0;
+
+    bool rebuild = false;
+    if (colIndex != NULL) {
+        long long buildings = colIndex->root != NULL ? colIndex->root->nodeCount : 0;
+        rebuild = (long long)blocks.size() * 16 > buildings;
+
+        long long offset;
+        ptr = ColonyIndexFindEmptyBlock(*colIndex, blocks[0], offset);
+        base = ptr != NULL ? blocks[0] - offset : ColonyIndexTotalEmptyBlocks(*colIndex);
     }
 
-    //CONDITION1, there is no need to append new dashes, there is room within the array, implement the modifications to colony string
-    if (dashamount >= index){
+    for (; ptr != NULL && k < blocks.size(); ptr = ptr->next) {
 
-        #ifdef DEBUG
-        cout << "DEBUG: CONDITION 1 INVOKED ! (dashamount >= index)" << endl;
-        #endif
+        long long gapEnd = base + ptr->emptyBlocks2TheLeft;
+        long long last = base; // last block of the gap taken so far
+        size_t first = k;
 
-        int indexavailable = 0;
-        for(int i = 0; i < COLONYSTRING.size(); i++){
+        while (k < blocks.size() && blocks[k] <= gapEnd) {
+            last = blocks[k++];
+        }
+        if (k == first) {
+            base = gapEnd;
+            continue;
+        }
 
-            if(COLONYSTRING[i] == '-'){
-                indexavailable++;
-            }
-            if(indexavailable == index){
+        // The dashes right of the last taken block stay with ptr
+        ptr->emptyBlocks2TheLeft = (int)(gapEnd - last);
+        if (colIndex != NULL && !rebuild) ColonyIndexGapChanged(ptr);
 
-                COLONYSTRING.insert(i, 1, buildingType); // Insert the building at the specified index once
-                COLONYSTRING.erase(i+1, 1); // Remove one '-' after inserting the building since we didnt overwrite anything in the previous statement
-                break;
+        long long previous = base;
+        for (size_t i = first; i < k; i++) {
+
+            colonyNode* newNode = new colonyNode(buildingType, (int)(blocks[i] - previous - 1), ptr, ptr->prev);
+            if (ptr->prev != NULL) {
+                ptr->prev->next = newNode;
+            } else {
+                head = newNode;
             }
+            ptr->prev = newNode;
+            previous = blocks[i];
+
+            if (colIndex != NULL && !rebuild) ColonyIndexInsertBefore(*colIndex, newNode, ptr);
         }
 
-        //Now that we have the correct string, encode it to a brand new DLL
+        base = gapEnd;
+    }
 
-        colonyNode* newColHead = encodeColony(COLONYSTRING); //encode the string to a DLL and point local newColHead to that DLL
+    // Ran past the last building, new dashes are needed on the right end
+    for (long long previous = base; k < blocks.size(); k++) {
+        ColonyAddToEnd(head, tail, buildingType, (int)(blocks[k] - previous - 1));
+        previous = blocks[k];
 
-        DeleteAll(colonyHead); // discard old DLL, original colony head points to garbage.
+        if (colIndex != NULL && !rebuild) ColonyIndexInsertBefore(*colIndex, tail, NULL);
+    }
 
-        colonyHead = newColHead; // Re-point the original pointer to the newly created DLL.
+    if (rebuild) ColonyIndexBuild(head, *colIndex);
+}
 
-        while (newColHead && newColHead->next) { // Locate new tail
-        newColHead = newColHead->next;
-        }
-        colonyTail = newColHead; // Re-point the orijinal tail ptr to the fresh DLL's tail.
 
-        cout << "Building of type " << buildingType << " has been added at the empty block number: " << index << endl;
 
-    } else {
 
-        //CONDITION2, there is a need to append new dashes, there is no room within the array, implement the modifications to colony string
+/* @brief Checks and deducts the resources of one building in a single walk over the stock DLL (a small transaction).
+ *
+ * @param "stockHead" [in][out] Pointer to the head of the stock DLL.
+ *
+ * @param "qtys" [in] Consumption quantities of the building, i'th entry belongs to the i'th stock node.
+ *
+ * @param "shortNode" [out] Set to the first stock node that can not cover its quantity, untouched on success.
+ *
+ * @post On success every quantity is deducted and true is returned.
+ *       On failure the already deducted nodes are restored by walking back over the prev links, so the stock is unchanged, and false is returned.
+ *       Quantities beyond the last stock node are ignored.
+ *
+ * @see ReleaseResources
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+bool ReserveResources(stockNode* stockHead, const vector<int>& qtys, stockNode*& shortNode) {
 
-        #ifdef DEBUG
-        cout << "DEBUG: CONDITION 2 INVOKED ! (dashamount < index)" << endl;
-        #endif
+    stockNode* stockPtr = stockHead;
+    int i = 0;
 
-        // Append the necessary number of dashes to the string
-        while (dashamount < index) {
-            COLONYSTRING += '-';
-            dashamount++;
-        }
+    for (; i < qtys.size() && stockPtr != NULL; i++) {
 
-        // Replace the last dash of the charray with the building type
-        COLONYSTRING.back() = buildingType;
+        if (stockPtr->resourceQuantity < qtys[i]) {
 
-        // encode the modified string to a new DLL, do pointer arrangements
-        colonyNode* newColHead = encodeColony(COLONYSTRING);
-        DeleteAll(colonyHead);
-        colonyHead = newColHead;
+            shortNode = stockPtr;
 
-        while (newColHead && newColHead->next) {
-            newColHead = newColHead->next;
+            // Rollback, walk back over what has been deducted so far
+            while (i > 0) {
+                i--;
+                stockPtr = stockPtr->prev;
+                stockPtr->resourceQuantity += qtys[i];
+            }
+            return false;
         }
-        colonyTail = newColHead;  // Update the tail pointer
 
-        cout << "Building of type " << buildingType << " has been added at the empty block number: " << index << endl;
+        stockPtr->resourceQuantity -= qtys[i];
+        stockPtr = stockPtr->next;
+    }
+
+    return true;
+}
+
+
+
+
+/* @brief Gives the resources of one building back to the stock DLL.
+ *
+ * @param "stockHead" [in][out] Pointer to the head of the stock DLL.
+ *
+ * @param "qtys" [in] Consumption quantities of the building.
+ *
+ * @see ReserveResources
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ReleaseResources(stockNode* stockHead, const vector<int>& qtys) {
+
+    stockNode* stockPtr = stockHead;
+    for (int i = 0; i < qtys.size() && stockPtr != NULL; i++) {
+        stockPtr->resourceQuantity += qtys[i];
+        stockPtr = stockPtr->next;
     }
 }
 
@@ -834,20 +1193,11 @@ void ConstructNewBuilding(colonyNode*& colonyHead, colonyNode*& colonyTail, cons
  * @pre the data is stored in DLL
  *
  * @post the data is now stored in a string, DLL still exists
- *
- * @note This is a helper function for ConstructNewBuilding
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 string decodeColony(colonyNode* head) {
-    string colonyStr = "";
-    colonyNode* ptr = head;
 
-    while (ptr != NULL) {
-        for (int i = 0; i < ptr->emptyBlocks2TheLeft; i++) {
-            colonyStr += '-';
-        }
-        colonyStr += ptr->buildType;
-        ptr = ptr->next;
-    }
+    string colonyStr(DecodedColonyLength(head), '-');
+    RenderDecodedColony(head, &colonyStr[0]);
 
     return colonyStr;
 }
@@ -862,8 +1212,6 @@ string decodeColony(colonyNode* head) {
  * @pre the data is stored in string
  *
  * @post the data is now stored in a DLL, string still exists
- *
- * @note This is a helper function for ConstructNewBuilding
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 colonyNode* encodeColony(const string& COLONYSTRING) {
 
@@ -9,9 +9,14 @@
 #include <fstream>
 #include <iomanip>
 #include <vector>
+#include <chrono>
+#include <type_traits>
+#include "nodepool.h"
 
 using namespace std;
 
+#define COLONY_BLOCK_SIZE (1 << 20) // ColonyLoader reads the colony file in 1 MiB chunks
+
 // Struct definitions
 //------------------------------------------------------------------------------------------
 struct stockNode{
@@ -25,6 +30,9 @@ struct stockNode{
     stockNode(string s = "", int i = -1, stockNode* n = NULL, stockNode*p = NULL):
     resourceName(s), resourceQuantity(i), next(n), prev(p) {}
 
+    static void* operator new(size_t) { return nodePool<stockNode>::local().allocate(); }
+    static void operator delete(void* ptr) { nodePool<stockNode>::deallocate(ptr); }
+
 };
 
 struct consumpNode{
@@ -37,6 +45,9 @@ struct consumpNode{
 
     consumpNode(char ch= '\0', vector<int>v = {}, consumpNode* n = NULL, consumpNode*p = NULL) :
     buildType(ch), consumpQtys(v), next(n), prev(p) {};
+
+    static void* operator new(size_t) { return nodePool<consumpNode>::local().allocate(); }
+    static void operator delete(void* ptr) { nodePool<consumpNode>::deallocate(ptr); }
 };
 
 struct colonyNode{
@@ -47,33 +58,176 @@ struct colonyNode{
     colonyNode *next;
     colonyNode *prev;
 
+    // Positional index (colonyindex.h): the same nodes also form a treap in list order, augmented with subtree sums
+    colonyNode *left;
+    colonyNode *right;
+    colonyNode *parent;
+    unsigned priority;
+    long long gapSum;       // emptyBlocks2TheLeft summed over the subtree
+    long long nodeCount;    // buildings in the subtree
+    unsigned long long typeMask;    // bit (c & 63) is set if a building of type c is in the subtree, see HasType
+
     colonyNode(char c = '\0', int i = -1, colonyNode* n = NULL, colonyNode* p = NULL) :
-    buildType(c), emptyBlocks2TheLeft(i), next(n), prev(p) {}
+    buildType(c), emptyBlocks2TheLeft(i), next(n), prev(p),
+    left(NULL), right(NULL), parent(NULL), priority(0), gapSum(i), nodeCount(1), typeMask(1ULL << ((unsigned char)c & 63)) {}
+
+    // Nodes live in slabs of nodePool (nodepool.h), a bulk load is a handful of allocations and neighbours stay close in memory
+    static void* operator new(size_t) { return nodePool<colonyNode>::local().allocate(); }
+    static void operator delete(void* ptr) { nodePool<colonyNode>::deallocate(ptr); }
+};
+
+// Filled by ColonyLoader for throughput reports (MB/s = bytes / 1e6 / seconds)
+struct colonyLoadStats{
+
+    long long bytes;
+    double seconds;
+
+    colonyLoadStats() : bytes(0), seconds(0) {}
+};
+
+// Outcome of the prompt-free colony operations (ConstructBuilding, DestroyBuilding, the loaders, colony.h)
+enum colonyResult { COLONY_OK, COLONY_UNKNOWN_TYPE, COLONY_BAD_INDEX, COLONY_INSUFFICIENT, COLONY_NOT_FOUND, COLONY_OPEN_FAILED, COLONY_BAD_SNAPSHOT, COLONY_BAD_JOURNAL };
+
+// A colonyResult together with what it is about, the caller decides how to tell the user
+struct colonyStatus{
+
+    colonyResult result;
+    char buildType;     // the building type the failure is about
+    string detail;      // COLONY_INSUFFICIENT: the resource that ran short, COLONY_OPEN_FAILED / COLONY_BAD_SNAPSHOT / COLONY_BAD_JOURNAL: the file name
+
+    colonyStatus(colonyResult r = COLONY_OK, char c = '\0', string d = "") :
+    result(r), buildType(c), detail(d) {}
+};
+
+// Direct-indexed side table over the consumption DLL, one slot per possible buildType char
+struct consumpTable{
+
+    consumpNode* recipe[256];
+
+    consumpTable() {
+        for (int i = 0; i < 256; i++) recipe[i] = NULL;
+    }
 };
 //------------------------------------------------------------------------------------------
 //
 // Function prototypes
 //------------------------------------------------------------------------------------------
-void fileOpenner(ifstream &file, string typeOfInput);
+struct colonyIndex; // colonyindex.h
 stockNode* StockLoader(ifstream &file, stockNode*& head,stockNode*& tail);
 void StockAddToEnd(stockNode*& head, stockNode*& tail, string ResType, int quantity);
 void PrintStockDEBUG(stockNode* head);
-void ConsumptionAddToEnd(consumpNode*& head, consumpNode*& tail, char BuildingType, vector<int> quantities);
-consumpNode* ConsumptionLoader(ifstream&file, consumpNode*& head, consumpNode*& tail);
+void ConsumptionAddToEnd(consumpNode*& head, consumpNode*& tail, char BuildingType, vector<int> quantities, consumpTable* table = NULL);
+consumpNode* ConsumptionLoader(ifstream&file, consumpNode*& head, consumpNode*& tail, consumpTable& table);
+void ConsumptionIndexBuild(consumpNode* head, consumpTable& table);
+consumpNode* FindConsumption(const consumpTable& table, char buildType);
 void PrintConsumptionDEBUG(consumpNode* head);
 void ColonyAddToEnd(colonyNode*& head, colonyNode*& tail, char BuildingType, int emptyBlocks);
-colonyNode* ColonyLoader(colonyNode*& head, colonyNode*& tail, stockNode* stockHead, consumpNode* consumpHead,ifstream &fileSTOCK,ifstream &fileCONSUMPTION,ifstream &fileCOLONY);
+const char* ColonyParseBlock(const char* p, const char* end, int& emptyBlocks, colonyNode*& head, colonyNode*& tail, stockNode* stockHead, const consumpTable& table, stockNode*& shortNode);
+void ColonyParseBlockTrusted(const char* p, const char* end, int& emptyBlocks, colonyNode*& head, colonyNode*& tail, long long& block, unsigned long long& hash);
+colonyStatus ColonyLoader(colonyNode*& head, colonyNode*& tail, stockNode* stockHead, const consumpTable& table, ifstream &fileCOLONY, colonyLoadStats* stats = NULL, unsigned long long* trustedHash = NULL);
+colonyStatus ColonyLoadFailure(colonyNode*& head, colonyNode*& tail, const char* bad, stockNode* shortNode);
 void PrintColonyDEBUG(colonyNode* head);
 template <typename Node> void DeleteAll(Node*& head);
+template <typename Node> void ReleaseAll(Node*& head);
 void PrintStock(stockNode* head);
 void PrintColony(colonyNode* head);
-void PrintColonyReverse(colonyNode* node, string& tempStr);
+void PrintColonyReverse(colonyNode* tail);
 void PrintColonyWithInnerEmptyBlocks(colonyNode* head);
 void reverseString(string& str);
 void PrintColonyWithInnerEmptyBlocksREVERSE(colonyNode* head);
-void DeleteBuildingFromColony(colonyNode*& colonyHead, char buildingType, consumpNode* consumpHead, stockNode* stockHead);
-void ConstructNewBuilding(colonyNode*& colonyHead, colonyNode*& colonyTail, consumpNode* consumpHead, stockNode* stockHead);
+colonyResult DestroyBuilding(colonyNode*& colonyHead, colonyNode*& colonyTail, char buildingType, const consumpTable& table, stockNode* stockHead, colonyIndex* colIndex = NULL);
+colonyResult ConstructBuilding(colonyNode*& colonyHead, colonyNode*& colonyTail, const consumpTable& table, stockNode* stockHead, char buildingType, int index, stockNode*& shortNode, colonyIndex* colIndex = NULL);
+void ColonyRemoveBuilding(colonyNode*& colonyHead, colonyNode*& colonyTail, colonyNode* node, colonyIndex* colIndex = NULL);
+long long ColonyRemoveType(colonyNode*& colonyHead, colonyNode*& colonyTail, char buildingType, long long limit, colonyIndex* colIndex = NULL);
+long long ColonyRemoveRange(colonyNode*& colonyHead, colonyNode*& colonyTail, long long first, long long end, long long* counts, colonyIndex* colIndex = NULL);
 string decodeColony(colonyNode* head);
 colonyNode* encodeColony(const string& COLONYSTRING);
+colonyNode* ColonyInsertAtEmptyBlock(colonyNode*& head, colonyNode*& tail, char buildingType, int index, colonyIndex* colIndex = NULL);
+void ColonyInsertAtEmptyBlocks(colonyNode*& head, colonyNode*& tail, char buildingType, const vector<long long>& blocks, colonyIndex* colIndex = NULL);
+bool ReserveResources(stockNode* stockHead, const vector<int>& qtys, stockNode*& shortNode);
+void ReleaseResources(stockNode* stockHead, const vector<int>& qtys);
 //------------------------------------------------------------------------------------------
+
+
+
+
+/* @brief Deletes all nodes in a given doubly linked list (DLL) and deallocates memory.
+ *
+ * @tparam Node A template parameter representing the type of node in the DLL. (stock/consumption/colony)
+ *
+ * @param "head" [in] Reference to the head pointer of the entered DLL.
+ *
+ * @pre The head pointer points to the first node of the DLL or be null if the list is empty.
+ *
+ * @post All nodes in the DLL are deleted and their memory is deallocated. The head pointer is set to NULL
+ *
+ * @note Debug code included
+ *
+ * @note Defined in the header so that every translation unit can instantiate it (optimized builds used to fail to link)
+ *
+ * @note Dersi 3. alışım, templated kullanmamış olup 3 ayrı fonk yazsaydım sağlam günaha girmiş olurdum
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename Node>
+void DeleteAll(Node*& head) {
+    #ifdef DEBUG
+    cout << "DEBUG: DELETING THE LINKED LIST" << endl;
+    #endif
+
+    while(head != NULL){
+        Node* temp = head;
+        head = head->next;
+        delete temp;
+    }
+}
+
+
+
+
+/* @brief O(1) teardown of a DLL by giving the whole node pool of this thread back at once.
+ *
+ * @tparam Node The node type of the DLL.
+ *
+ * @param "head" [in][out] Reference to the head pointer of the DLL, set to NULL.
+ *
+ * @pre The DLL holds every live node of its type that was allocated on this thread (e.g. the colony at menu option 8),
+ *      and no other thread is using or freeing any of them.
+ *
+ * @post The slabs are freed without visiting the nodes. Node types that own memory (string/vector members) still need
+ *       their destructors, those fall back to DeleteAll.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename Node>
+void ReleaseAll(Node*& head) {
+
+    if constexpr (is_trivially_destructible<Node>::value) {
+        nodePool<Node>::local().release();
+        head = NULL;
+    } else {
+        DeleteAll(head);
+    }
+}
+
+
+
+
+/* @brief Folds one 64 bit word into a running FNV-1a style hash (the checksum of a trusted save, colony.h), a word at
+ *        a time instead of a byte at a time so that a building costs one multiply.
+ *
+ * @note Defined in the header so that the trusted colony loader can fold it in while it builds the nodes.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+inline unsigned long long HashWord(unsigned long long hash, unsigned long long value) {
+
+    return (hash ^ value) * 1099511628211ULL;
+}
+
+// The term a building at a block (counting every position from 1) adds to the colony part of that checksum. The terms
+// are summed: construction and destruction never move the other blocks, so a change only adds or takes away the terms
+// of the blocks it touches (a splitmix64 finalizer spreads the bits of the block and the type)
+inline unsigned long long ColonyBlockTerm(long long block, char buildType) {
+
+    unsigned long long z = ((unsigned long long)block << 8 | (unsigned char)buildType) + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,359 @@
+#include "journal.h"
+#include "mapped.h"
+#include "snapshot.h"
+
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define HAVE_POSIX_FSYNC
+#endif
+
+//#define DEBUG
+
+/* @brief CRC-32 (IEEE 802.3, reflected) of a block of bytes, the checksum of journal records.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static unsigned int JournalCrc(const char* data, size_t size) {
+
+    static const vector<unsigned int> table = [] {
+        vector<unsigned int> t(256);
+        for (unsigned int i = 0; i < 256; i++) {
+            unsigned int c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    unsigned int crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+
+
+
+/* @brief Stores the low "bytes" bytes of a value at p, little endian.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void PutLittle(char* p, unsigned long long value, int bytes) {
+
+    for (int i = 0; i < bytes; i++) {
+        p[i] = (char)(value & 0xff);
+        value >>= 8;
+    }
+}
+
+
+
+
+/* @brief Reads a little endian value of "bytes" bytes at p.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static unsigned long long GetLittle(const char* p, int bytes) {
+
+    unsigned long long value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (unsigned long long)(unsigned char)p[i] << (8 * i);
+    }
+    return value;
+}
+
+
+
+
+/* @brief The header of a journal whose records apply to a state.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static string JournalHeader(const colonyState& state) {
+
+    string header(COLONY_JOURNAL_HEADER, '\0');
+    memcpy(&header[0], "CJNL", 4);
+    PutLittle(&header[4], COLONY_JOURNAL_VERSION, 4);
+    PutLittle(&header[8], ColonyStateChecksum(state), 8);
+    return header;
+}
+
+
+
+
+/* @brief Pushes what has been written to a journal file down to the disk.
+ *
+ * @return false if the flush or the sync failed, the records may then not be on the disk.
+ *
+ * @note Without POSIX fsync the bytes only reach the OS, which survives a crash of the program but not of the machine.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static bool SyncFile(FILE* file) {
+
+    if (fflush(file) != 0) return false;
+
+    #ifdef HAVE_POSIX_FSYNC
+    if (fsync(fileno(file)) != 0) return false;
+    #endif
+
+    return true;
+}
+
+
+
+
+/* @brief Writes and syncs every pending record as one batch (the group commit).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void CommitPending(colonyJournal& journal) {
+
+    lock_guard<mutex> write(journal.writeLock);
+    {
+        lock_guard<mutex> pending(journal.pendingLock);
+        journal.writing.swap(journal.pending);
+    }
+
+    if (journal.writing.empty() || journal.file == NULL) return;
+
+    bool written = fwrite(journal.writing.data(), 1, journal.writing.size(), journal.file) == journal.writing.size();
+    if (!SyncFile(journal.file) || !written) {
+        lock_guard<mutex> pending(journal.pendingLock);
+        journal.failed = true;
+    }
+
+    #ifdef DEBUG
+    cout << "DEBUG: JOURNAL COMMITTED " << journal.writing.size() / COLONY_JOURNAL_RECORD << " RECORDS" << endl;
+    #endif
+
+    journal.writing.clear();
+}
+
+
+
+
+/* @brief Body of the flusher thread: one group commit per interval until the journal is closed.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void FlushLoop(colonyJournal* journal) {
+
+    while (true) {
+        {
+            unique_lock<mutex> lock(journal->pendingLock);
+            journal->wake.wait_for(lock, chrono::microseconds(journal->interval), [journal] { return journal->stopping; });
+            if (journal->stopping) return;
+        }
+        CommitPending(*journal);
+    }
+}
+
+
+
+
+/* @brief Applies one record to the state through the colony API.
+ *
+ * @return false if the record does not replay to the change it recorded, i.e. the journal does not fit the state.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static bool JournalApply(colonyState& state, char op, char buildType, long long a, long long b) {
+
+    long long count = 0;
+
+    switch (op) {
+        case JOURNAL_CONSTRUCT:
+            return a >= 1 && a <= INT_MAX && ColonyConstruct(state, buildType, (int)a).result == COLONY_OK;
+        case JOURNAL_DESTROY:
+            return ColonyDestroy(state, buildType).result == COLONY_OK;
+        case JOURNAL_CONSTRUCT_FIRST_FIT:
+            ColonyConstructFirstFit(state, buildType, a, count);
+            return count == b;
+        case JOURNAL_DESTROY_MANY:
+            ColonyDestroyMany(state, buildType, a, count);
+            return count == b;
+        case JOURNAL_DESTROY_RANGE:
+            return ColonyDestroyRange(state, a, b, count).result == COLONY_OK;
+    }
+    return false;
+}
+
+
+
+
+/* @brief Opens (or creates) the journal of a state that has just been loaded, and replays the records it already holds.
+ *
+ * @param "filename" [in] Name of the journal file, created with a fresh header if it does not exist or is empty.
+ *
+ * @param "state" [in][out] The loaded colony, the records of the journal are applied to it.
+ *
+ * @param "interval" [in] Group commit interval in microseconds, 0 to sync every record on its own. A negative interval
+ *                        is taken as 0, a journal that is never synced would not be one.
+ *
+ * @param "replayed" [out] Number of records applied.
+ *
+ * @return COLONY_OK, COLONY_OPEN_FAILED or COLONY_BAD_JOURNAL (detail = the file name) if the file is not a journal or
+ *         was written on top of another state than the loaded one (the base checksum of its header does not match).
+ *
+ * @post A record cut short at the end of the file (a crash in the middle of a write) is dropped from the file.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus JournalOpen(colonyJournal& journal, const string& filename, colonyState& state, long long interval, long long& replayed) {
+
+    replayed = 0;
+    journal.filename = filename;
+    journal.interval = interval < 0 ? 0 : interval;
+
+    mappedFile bytes;
+    if (MapFile(filename, bytes) && bytes.size > 0) {
+
+        const char* data = bytes.data;
+
+        if (bytes.size < COLONY_JOURNAL_HEADER || memcmp(data, "CJNL", 4) != 0 || GetLittle(data + 4, 4) != COLONY_JOURNAL_VERSION ||
+            GetLittle(data + 8, 8) != ColonyStateChecksum(state)) {
+            UnmapFile(bytes);
+            return colonyStatus(COLONY_BAD_JOURNAL, '\0', filename);
+        }
+
+        size_t good = COLONY_JOURNAL_HEADER;
+        while (bytes.size - good >= COLONY_JOURNAL_RECORD) {
+
+            const char* record = data + good;
+            if (GetLittle(record, 4) != JournalCrc(record + 4, COLONY_JOURNAL_RECORD - 4)) break;
+
+            if (!JournalApply(state, record[4], record[5], (long long)GetLittle(record + 8, 8), (long long)GetLittle(record + 16, 8))) {
+                UnmapFile(bytes);
+                return colonyStatus(COLONY_BAD_JOURNAL, '\0', filename);
+            }
+
+            replayed++;
+            good += COLONY_JOURNAL_RECORD;
+        }
+
+        // Cut off the torn tail so that new records follow the last good one
+        bool ok = good == bytes.size || WriteFileReplacing(filename, string(data, good));
+        UnmapFile(bytes);
+
+        if (!ok) return colonyStatus(COLONY_OPEN_FAILED, '\0', filename);
+
+    } else {
+        UnmapFile(bytes);
+        if (!WriteFileReplacing(filename, JournalHeader(state))) {
+            return colonyStatus(COLONY_OPEN_FAILED, '\0', filename);
+        }
+    }
+
+    journal.file = fopen(filename.c_str(), "ab");
+    if (journal.file == NULL) return colonyStatus(COLONY_OPEN_FAILED, '\0', filename);
+
+    journal.records = replayed;
+    journal.stopping = false;
+    journal.failed = false;
+
+    if (journal.interval > 0) {
+        journal.flusher = thread(FlushLoop, &journal);
+    }
+
+    #ifdef DEBUG
+    cout << "DEBUG: JOURNAL " << filename << " REPLAYED " << replayed << " RECORDS" << endl;
+    #endif
+
+    return colonyStatus(COLONY_OK);
+}
+
+
+
+
+/* @brief Records an operation that has just changed the colony.
+ *
+ * @param "op" [in] Which colony call replays it, a and b are its arguments (see journalOp).
+ *
+ * @post With a group commit interval the record is durable once the next batch is synced (at most one interval later),
+ *       the call itself only appends 24 bytes to the pending batch. With an interval of 0 it is synced before returning.
+ *
+ * @return false if the journal is no longer written (a failed batch or a failed JournalCheckpoint), the change is not
+ *         recorded. A batch of the flusher that fails is reported by the next call.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+bool JournalAppend(colonyJournal& journal, journalOp op, char buildType, long long a, long long b) {
+
+    if (journal.file == NULL) return false;
+
+    char record[COLONY_JOURNAL_RECORD] = {0};
+    record[4] = (char)op;
+    record[5] = buildType;
+    PutLittle(record + 8, (unsigned long long)a, 8);
+    PutLittle(record + 16, (unsigned long long)b, 8);
+    PutLittle(record, JournalCrc(record + 4, COLONY_JOURNAL_RECORD - 4), 4);
+
+    {
+        lock_guard<mutex> lock(journal.pendingLock);
+        if (journal.failed) return false;
+        journal.pending.append(record, COLONY_JOURNAL_RECORD);
+    }
+    journal.records++;
+
+    if (journal.interval == 0) {
+        CommitPending(journal);
+    }
+
+    lock_guard<mutex> lock(journal.pendingLock);
+    return !journal.failed;
+}
+
+
+
+
+/* @brief Writes and syncs the pending records now instead of waiting for the flusher.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void JournalSync(colonyJournal& journal) {
+
+    if (journal.file != NULL) CommitPending(journal);
+}
+
+
+
+
+/* @brief Starts the journal over on top of the current state, after the state has been saved somewhere else
+ *        (ColonyStateSaveTrusted) or replaced (ColonySnapshotLoad).
+ *
+ * @return COLONY_OK, or COLONY_OPEN_FAILED (detail = the file name). The old records do not apply to the new state
+ *         anymore, so after a failure the journal stops recording and every JournalAppend returns false.
+ *
+ * @post The new header replaces the file in one rename (WriteFileReplacing), a crash leaves either journal whole.
+ *       From now on the journal only replays on top of a state with the same checksum as this one.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus JournalCheckpoint(colonyJournal& journal, const colonyState& state) {
+
+    if (journal.file == NULL) return colonyStatus(COLONY_OK);
+
+    CommitPending(journal);
+
+    lock_guard<mutex> write(journal.writeLock);
+
+    fclose(journal.file);
+    bool ok = WriteFileReplacing(journal.filename, JournalHeader(state));
+    journal.file = ok ? fopen(journal.filename.c_str(), "ab") : NULL;
+
+    if (journal.file == NULL) {
+        lock_guard<mutex> pending(journal.pendingLock);
+        journal.failed = true;
+        return colonyStatus(COLONY_OPEN_FAILED, '\0', journal.filename);
+    }
+
+    journal.records = 0;
+    return colonyStatus(COLONY_OK);
+}
+
+
+
+
+/* @brief Stops the flusher, commits what is still pending and closes the file. Safe to call on a journal that was never opened.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void JournalClose(colonyJournal& journal) {
+
+    if (journal.flusher.joinable()) {
+        {
+            lock_guard<mutex> lock(journal.pendingLock);
+            journal.stopping = true;
+        }
+        journal.wake.notify_one();
+        journal.flusher.join();
+    }
+
+    if (journal.file != NULL) {
+        CommitPending(journal);
+        fclose(journal.file);
+        journal.file = NULL;
+    }
+}
@@ -0,0 +1,74 @@
+// Append-only journal of the colony mutations, replayed on top of the input files at start-up
+
+#ifndef _JOURNAL_
+#define _JOURNAL_
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "colony.h"
+
+using namespace std;
+
+// Layout of a journal file, all integers little endian:
+//
+//   magic    "CJNL"                                  4 bytes
+//   version  COLONY_JOURNAL_VERSION                  4 bytes
+//   base     ColonyStateChecksum of the state the records apply to   8 bytes
+//   records  COLONY_JOURNAL_RECORD bytes each:       4 byte CRC-32 of the 20 bytes after it, 1 byte op,
+//                                                    1 byte buildType, 2 zero bytes, 8 byte a, 8 byte b
+//
+// A record is only written for an operation that changed the colony, replaying it through the colony API gives the same
+// change again. Replay stops at the first record that is cut short or fails its CRC (a crash in the middle of a write),
+// the file is cut back to the records before it.
+//------------------------------------------------------------------------------------------
+#define COLONY_JOURNAL_VERSION 1
+#define COLONY_JOURNAL_HEADER 16
+#define COLONY_JOURNAL_RECORD 24
+//------------------------------------------------------------------------------------------
+//
+// Struct definitions
+//------------------------------------------------------------------------------------------
+// What a record replays, a and b are the arguments of the colony call
+enum journalOp {
+    JOURNAL_CONSTRUCT = 'C',            // ColonyConstruct, a = empty block number
+    JOURNAL_DESTROY = 'D',              // ColonyDestroy
+    JOURNAL_CONSTRUCT_FIRST_FIT = 'F',  // ColonyConstructFirstFit, a = count, b = buildings it placed
+    JOURNAL_DESTROY_MANY = 'M',         // ColonyDestroyMany, a = limit, b = buildings it removed
+    JOURNAL_DESTROY_RANGE = 'R'         // ColonyDestroyRange, a = first block, b = end block
+};
+
+// An open journal. Records are collected in memory and written + synced to disk together (group commit) by a flusher
+// thread every "interval" microseconds, with an interval of 0 every record is synced before JournalAppend returns.
+struct colonyJournal{
+
+    FILE* file;
+    string filename;
+    long long interval;         // group commit interval in microseconds
+
+    mutex pendingLock;          // guards pending, stopping and failed
+    mutex writeLock;            // one batch is written and synced at a time, in order
+    condition_variable wake;
+    thread flusher;
+    bool stopping;
+    bool failed;                // a batch could not be written or the file could not be reopened, nothing is recorded anymore
+
+    string pending;             // encoded records not written yet
+    string writing;             // the batch being written, kept to reuse its capacity
+    long long records;          // records in the file (or pending) after the header
+
+    colonyJournal() : file(NULL), interval(0), stopping(false), failed(false), records(0) {}
+};
+//------------------------------------------------------------------------------------------
+//
+// Function prototypes
+//------------------------------------------------------------------------------------------
+colonyStatus JournalOpen(colonyJournal& journal, const string& filename, colonyState& state, long long interval, long long& replayed);
+bool JournalAppend(colonyJournal& journal, journalOp op, char buildType, long long a = 0, long long b = 0);
+void JournalSync(colonyJournal& journal);
+colonyStatus JournalCheckpoint(colonyJournal& journal, const colonyState& state);
+void JournalClose(colonyJournal& journal);
+//------------------------------------------------------------------------------------------
+#endif
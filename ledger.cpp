@@ -0,0 +1,287 @@
+#include "ledger.h"
+
+#include <climits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LEDGER_AVX2
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define LEDGER_SSE42
+#endif
+
+//#define DEBUG
+
+/* @brief Copies the stock DLL into a contiguous ledger.
+ *
+ * @param "head" [in] Pointer to the head of the stock DLL.
+ *
+ * @param "ledger" [out] The ledger to be (re)filled.
+ *
+ * @post ledger.names / ledger.quantities follow the order of the DLL, the padding lanes are zero.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void LedgerFromStock(stockNode* head, stockLedger& ledger) {
+
+    ledger.names.clear();
+    for (stockNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+        ledger.names.push_back(ptr->resourceName);
+    }
+
+    ledger.size = ledger.names.size();
+    ledger.width = (ledger.size + 3) / 4 * 4;
+    ledger.quantities.assign(ledger.width, 0);
+
+    int i = 0;
+    for (stockNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+        ledger.quantities[i++] = ptr->resourceQuantity;
+    }
+}
+
+
+
+
+/* @brief Writes the ledger quantities back into the stock DLL it was created from.
+ *
+ * @param "ledger" [in] The ledger holding the up to date quantities.
+ *
+ * @param "head" [in][out] Pointer to the head of the stock DLL.
+ *
+ * @pre The DLL still has the layout the ledger was built from.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void LedgerToStock(const stockLedger& ledger, stockNode* head) {
+
+    int i = 0;
+    for (stockNode* ptr = head; ptr != NULL && i < ledger.size; ptr = ptr->next) {
+        ptr->resourceQuantity = (int)ledger.quantities[i++];
+    }
+}
+
+
+
+
+/* @brief Lays the recipes of the consumption table out as ledger wide rows.
+ *
+ * @param "table" [in] Recipe table of the consumption DLL.
+ *
+ * @param "ledger" [in] The ledger that decides the row width.
+ *
+ * @param "matrix" [out] The matrix to be (re)filled.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void RecipeMatrixBuild(const consumpTable& table, const stockLedger& ledger, recipeMatrix& matrix) {
+
+    matrix = recipeMatrix();
+    matrix.width = ledger.width;
+
+    int rowCount = 0;
+    for (int c = 0; c < 256; c++) {
+        if (table.recipe[c] != NULL) {
+            matrix.row[c] = rowCount++;
+        }
+    }
+
+    matrix.rows.assign((size_t)rowCount * 2 * matrix.width, 0);
+
+    for (int c = 0; c < 256; c++) {
+        if (matrix.row[c] == -1) continue;
+
+        const vector<int>& qtys = table.recipe[c]->consumpQtys;
+        long long* row = &matrix.rows[(size_t)matrix.row[c] * 2 * matrix.width];
+        long long* floor = row + matrix.width;
+
+        for (int i = 0; i < matrix.width; i++) {
+            floor[i] = LLONG_MIN;
+        }
+        for (int i = 0; i < (int)qtys.size() && i < ledger.size; i++) {
+            row[i] = qtys[i];
+            floor[i] = qtys[i];
+        }
+    }
+}
+
+
+
+
+/* @brief Returns the ledger wide recipe row of a building type, NULL if the type has no recipe.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+const long long* RecipeRow(const recipeMatrix& matrix, char buildType) {
+
+    int r = matrix.row[(unsigned char)buildType];
+    if (r == -1) return NULL;
+
+    return matrix.rows.data() + (size_t)r * 2 * matrix.width;
+}
+
+
+
+
+/* @brief Checks a recipe row against the whole ledger in one pass.
+ *
+ * @param "ledger" [in] The stock ledger.
+ *
+ * @param "recipe" [in] A row returned by RecipeRow, the comparison uses its floor row.
+ *
+ * @post Returns true if every resource quantity is at least the recipe amount.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+bool LedgerCanAfford(const stockLedger& ledger, const long long* recipe) {
+
+    const long long* stock = ledger.quantities.data();
+    const long long* floor = recipe + ledger.width;
+
+#if defined(LEDGER_AVX2)
+    __m256i shortfall = _mm256_setzero_si256();
+    for (int i = 0; i < ledger.width; i += 4) {
+        __m256i s = _mm256_load_si256((const __m256i*)(stock + i));
+        __m256i r = _mm256_load_si256((const __m256i*)(floor + i));
+        shortfall = _mm256_or_si256(shortfall, _mm256_cmpgt_epi64(r, s));
+    }
+    return _mm256_testz_si256(shortfall, shortfall);
+#elif defined(LEDGER_SSE42)
+    __m128i shortfall = _mm_setzero_si128();
+    for (int i = 0; i < ledger.width; i += 2) {
+        __m128i s = _mm_load_si128((const __m128i*)(stock + i));
+        __m128i r = _mm_load_si128((const __m128i*)(floor + i));
+        shortfall = _mm_or_si128(shortfall, _mm_cmpgt_epi64(r, s));
+    }
+    return _mm_movemask_epi8(shortfall) == 0;
+#else
+    bool ok = true;
+    for (int i = 0; i < ledger.width; i++) {
+        ok &= (stock[i] >= floor[i]);
+    }
+    return ok;
+#endif
+}
+
+
+
+
+/* @brief Finds the first resource (in stock order) that can not cover the recipe.
+ *
+ * @post Returns the resource index, -1 if the recipe is affordable. Matches the order the DLL based checks report in.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+int LedgerFirstShortfall(const stockLedger& ledger, const long long* recipe) {
+
+    if (LedgerCanAfford(ledger, recipe)) return -1;
+
+    const long long* floor = recipe + ledger.width;
+    for (int i = 0; i < ledger.size; i++) {
+        if (ledger.quantities[i] < floor[i]) return i;
+    }
+    return -1;
+}
+
+
+
+
+/* @brief How many copies of a recipe the ledger can cover, the minimum of quantity / amount over the consumed resources.
+ *
+ * @post Returns limit if the recipe consumes nothing (free or refunding recipes) and is affordable once, never more than limit, never below 0.
+ *       Deducting the result in one LedgerDeduct leaves the ledger exactly as that many successful LedgerTryDeduct calls would.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+long long LedgerAffordableTimes(const stockLedger& ledger, const long long* recipe, long long limit) {
+
+    const long long* floor = recipe + ledger.width;
+    long long times = limit;
+
+    for (int i = 0; i < ledger.size && times > 0; i++) {
+        long long quantity = ledger.quantities[i];
+        if (quantity < floor[i]) {
+            times = 0;  // not even one copy (also when a negative quantity meets a zero amount)
+        } else if (recipe[i] > 0) {
+            times = min(times, quantity / recipe[i]);
+        }
+    }
+    return times;
+}
+
+
+
+
+/* @brief Deducts "times" copies of a recipe from the ledger without checking.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void LedgerDeduct(stockLedger& ledger, const long long* recipe, long long times) {
+
+    long long* stock = ledger.quantities.data();
+
+    if (times != 1) {
+        for (int i = 0; i < ledger.width; i++) stock[i] -= recipe[i] * times;
+        return;
+    }
+
+#if defined(LEDGER_AVX2)
+    for (int i = 0; i < ledger.width; i += 4) {
+        __m256i s = _mm256_load_si256((const __m256i*)(stock + i));
+        __m256i r = _mm256_load_si256((const __m256i*)(recipe + i));
+        _mm256_store_si256((__m256i*)(stock + i), _mm256_sub_epi64(s, r));
+    }
+#elif defined(LEDGER_SSE42)
+    for (int i = 0; i < ledger.width; i += 2) {
+        __m128i s = _mm_load_si128((const __m128i*)(stock + i));
+        __m128i r = _mm_load_si128((const __m128i*)(recipe + i));
+        _mm_store_si128((__m128i*)(stock + i), _mm_sub_epi64(s, r));
+    }
+#else
+    for (int i = 0; i < ledger.width; i++) stock[i] -= recipe[i];
+#endif
+}
+
+
+
+
+/* @brief Gives "times" copies of a recipe back to the ledger.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void LedgerRefund(stockLedger& ledger, const long long* recipe, long long times) {
+
+    long long* stock = ledger.quantities.data();
+
+    if (times != 1) {
+        for (int i = 0; i < ledger.width; i++) stock[i] += recipe[i] * times;
+        return;
+    }
+
+#if defined(LEDGER_AVX2)
+    for (int i = 0; i < ledger.width; i += 4) {
+        __m256i s = _mm256_load_si256((const __m256i*)(stock + i));
+        __m256i r = _mm256_load_si256((const __m256i*)(recipe + i));
+        _mm256_store_si256((__m256i*)(stock + i), _mm256_add_epi64(s, r));
+    }
+#elif defined(LEDGER_SSE42)
+    for (int i = 0; i < ledger.width; i += 2) {
+        __m128i s = _mm_load_si128((const __m128i*)(stock + i));
+        __m128i r = _mm_load_si128((const __m128i*)(recipe + i));
+        _mm_store_si128((__m128i*)(stock + i), _mm_add_epi64(s, r));
+    }
+#else
+    for (int i = 0; i < ledger.width; i++) stock[i] += recipe[i];
+#endif
+}
+
+
+
+
+/* @brief Check-and-deduct in one call, the ledger is left untouched if the recipe is not affordable.
+ *
+ * @post Returns true if the recipe has been deducted.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+bool LedgerTryDeduct(stockLedger& ledger, const long long* recipe) {
+
+    if (!LedgerCanAfford(ledger, recipe)) return false;
+
+    LedgerDeduct(ledger, recipe);
+    return true;
+}
+
+
+
+
+/* @brief Name of the kernel flavour this translation unit was compiled with (for benchmark reports).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+const char* LedgerKernelName() {
+#if defined(LEDGER_AVX2)
+    return "avx2";
+#elif defined(LEDGER_SSE42)
+    return "sse4.2";
+#else
+    return "scalar";
+#endif
+}
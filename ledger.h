@@ -0,0 +1,83 @@
+// Contiguous stock ledger for planning runs
+
+#ifndef _LEDGER_
+#define _LEDGER_
+
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "functions.h"
+
+using namespace std;
+
+// Allocator that hands out 32 byte aligned blocks so that the ledger rows can be loaded with aligned AVX2 loads
+//------------------------------------------------------------------------------------------
+template <typename T>
+struct alignedAllocator{
+
+    typedef T value_type;
+
+    alignedAllocator() {}
+    template <typename U> alignedAllocator(const alignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        size_t bytes = (n * sizeof(T) + 31) / 32 * 32;
+        return (T*)::operator new(bytes == 0 ? 32 : bytes, align_val_t(32));
+    }
+    void deallocate(T* ptr, size_t) { ::operator delete(ptr, align_val_t(32)); }
+
+    bool operator==(const alignedAllocator&) const { return true; }
+    bool operator!=(const alignedAllocator&) const { return false; }
+};
+
+typedef vector<long long, alignedAllocator<long long> > alignedQtys;
+//------------------------------------------------------------------------------------------
+//
+// Struct definitions
+//------------------------------------------------------------------------------------------
+// Struct-of-arrays mirror of the stock DLL, quantities[i] belongs to names[i] (i'th node of the DLL).
+// quantities is zero padded up to width (a multiple of 4) so that the kernels never need a remainder loop.
+struct stockLedger{
+
+    vector<string> names;
+    alignedQtys quantities;
+
+    int size;
+    int width;
+
+    stockLedger() : size(0), width(0) {}
+};
+
+// Recipes of the consumption DLL laid out as rows of the same width as the ledger, row[c] is -1 if c has no recipe.
+// Recipe entries past the number of stock resources are dropped, missing entries are zero.
+// Every recipe row is followed by its floor row, the amounts the checks compare against: LLONG_MIN where the recipe has
+// no entry, because the DLL checks only look at the entries a recipe has (this matters once a quantity is negative).
+struct recipeMatrix{
+
+    alignedQtys rows;
+    int row[256];
+
+    int width;
+
+    recipeMatrix() : width(0) {
+        for (int i = 0; i < 256; i++) row[i] = -1;
+    }
+};
+//------------------------------------------------------------------------------------------
+//
+// Function prototypes
+//------------------------------------------------------------------------------------------
+void LedgerFromStock(stockNode* head, stockLedger& ledger);
+void LedgerToStock(const stockLedger& ledger, stockNode* head);
+void RecipeMatrixBuild(const consumpTable& table, const stockLedger& ledger, recipeMatrix& matrix);
+const long long* RecipeRow(const recipeMatrix& matrix, char buildType);
+bool LedgerCanAfford(const stockLedger& ledger, const long long* recipe);
+int LedgerFirstShortfall(const stockLedger& ledger, const long long* recipe);
+long long LedgerAffordableTimes(const stockLedger& ledger, const long long* recipe, long long limit);
+void LedgerDeduct(stockLedger& ledger, const long long* recipe, long long times = 1);
+void LedgerRefund(stockLedger& ledger, const long long* recipe, long long times = 1);
+bool LedgerTryDeduct(stockLedger& ledger, const long long* recipe);
+const char* LedgerKernelName();
+//------------------------------------------------------------------------------------------
+#endif
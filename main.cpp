@@ -3,58 +3,91 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
-#include "functions.h"
+#include <cstdlib>
+#include "colony.h"
+#include "cli.h"
+#include "journal.h"
+#include "snapshot.h"
 
 //#define DEBUG
 
 using namespace std;
 
-int main() {
-
-    //Stock Handling
-    ifstream input_stockfile;
-    fileOpenner(input_stockfile,"stock"); //stockX.txt is open ! bound to input_stockfile
-
-    stockNode* HEAD_STOCKNODE = NULL;
-    stockNode* TAIL_STOCKNODE = NULL;
-
-    HEAD_STOCKNODE = StockLoader(input_stockfile,HEAD_STOCKNODE, TAIL_STOCKNODE);
-
-    #ifdef DEBUG
-    PrintStockDEBUG(HEAD_STOCKNODE);
-    #endif
-
-
-    //Consumption Handling
-    ifstream input_consumptionfile;
-    fileOpenner(input_consumptionfile,"consumption"); //consumptionX.txt is open ! bound to input_consumptionfile
-
-    consumpNode* HEAD_CONSUMPTIONNODE = NULL;
-    consumpNode* TAIL_CONSUMPTIONNODE = NULL;
-
-    HEAD_CONSUMPTIONNODE = ConsumptionLoader(input_consumptionfile,HEAD_CONSUMPTIONNODE, TAIL_CONSUMPTIONNODE);
-
-    #ifdef DEBUG
-    PrintConsumptionDEBUG(HEAD_CONSUMPTIONNODE);
-    #endif
-
-
-    //Colony Handling
-    ifstream input_colonyfile;
-    fileOpenner(input_colonyfile,"colony"); //colonyX.txt is open ! bound to input_colonyfile
-
-    colonyNode* HEAD_COLONYNODE = NULL;
-    colonyNode* TAIL_COLONYNODE = NULL;
-
-    HEAD_COLONYNODE = ColonyLoader(HEAD_COLONYNODE, TAIL_COLONYNODE, HEAD_STOCKNODE, HEAD_CONSUMPTIONNODE,input_stockfile,input_consumptionfile,input_colonyfile);
-
-    #ifdef DEBUG
-    PrintColonyDEBUG(HEAD_COLONYNODE);
-    #endif
+int main(int argc, char* argv[]) {
+
+    // Batch mode: replay a command file without the menu
+    if (argc == 6 && string(argv[1]) == "--batch") {
+        return BatchMain(argv[2], argv[3], argv[4], argv[5]);
+    }
+
+    // --snapshot <file>: start from a snapshot saved with menu option 9 instead of the three text files
+    // --journal <file>: record every change of the colony, and replay what the file already holds on top of the loaded colony
+    // --group-commit <microseconds>: how often the journal is synced to disk, 0 syncs every change on its own
+    string snapshotFilename, journalFilename;
+    long long groupCommit = 2000;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--snapshot") snapshotFilename = argv[i + 1];
+        else if (option == "--journal") journalFilename = argv[i + 1];
+        else if (option == "--group-commit") groupCommit = atoll(argv[i + 1]);
+    }
+
+    if (groupCommit < 0) {
+        cout << "The group commit interval can not be negative." << endl;
+        return 1;
+    }
+
+    //Stock, consumption and colony handling, all of it lives in the colony core (colony.h)
+    colonyState COLONY;
+    colonyStatus status;
+
+    if (!snapshotFilename.empty()) {
+        status = ColonySnapshotLoad(COLONY, snapshotFilename);
+    } else {
+        //Input files
+        ifstream input_stockfile;
+        string stockFilename = fileOpenner(input_stockfile,"stock"); //stockX.txt is open ! bound to input_stockfile
+
+        ifstream input_consumptionfile;
+        string consumptionFilename = fileOpenner(input_consumptionfile,"consumption"); //consumptionX.txt is open ! bound to input_consumptionfile
+
+        ifstream input_colonyfile;
+        string colonyFilename = fileOpenner(input_colonyfile,"colony"); //colonyX.txt is open ! bound to input_colonyfile
+
+        input_stockfile.close();
+        input_consumptionfile.close();
+        input_colonyfile.close();
+
+        status = ColonyStateLoad(COLONY, stockFilename, consumptionFilename, colonyFilename);
+    }
+
+    if (status.result != COLONY_OK) {
+        PrintLoadFailure(status);
+        return 1;
+    }
+
+    // The journal, NULL without --journal
+    colonyJournal JOURNAL;
+    colonyJournal* journal = NULL;
+
+    if (!journalFilename.empty()) {
+
+        long long replayed;
+        status = JournalOpen(JOURNAL, journalFilename, COLONY, groupCommit, replayed);
+
+        if (status.result != COLONY_OK) {
+            PrintLoadFailure(status);
+            JournalClose(JOURNAL);
+            ColonyStateFree(COLONY);
+            return 1;
+        }
 
-    #ifdef DEBUG
-    PrintStockDEBUG(HEAD_STOCKNODE);
-    #endif
+        if (replayed > 0) {
+            cout << replayed << " operations have been replayed from the journal " << journalFilename << "." << endl;
+        }
+        journal = &JOURNAL;
+    }
 
 
     //Releasing the menu
@@ -69,6 +102,13 @@ int main() {
     cout << "6. Print the colony while showing inner empty blocks in reverse" << endl;
     cout << "7. Print the stock" << endl;
     cout << "8. Exit" << endl;
+    cout << "9. Save the colony to a snapshot file" << endl;
+    cout << "10. Load the colony from a snapshot file" << endl;
+    cout << "11. Save the stock and colony files for a fast restart" << endl;
+    cout << "12. Print the total consumption of the colony" << endl;
+    cout << "13. Construct several buildings of one type on the first empty blocks" << endl;
+    cout << "14. Destruct several buildings of one type from the colony" << endl;
+    cout << "15. Destruct every building in a range of blocks of the colony" << endl;
 
     while (running) {
 
@@ -84,7 +124,7 @@ int main() {
                 cout << "CASE 1 INVOKED !" << endl;
                 #endif
 
-                ConstructNewBuilding(HEAD_COLONYNODE, TAIL_COLONYNODE, HEAD_CONSUMPTIONNODE, HEAD_STOCKNODE);
+                ConstructNewBuilding(COLONY, journal);
 
                 break;
             case 2:
@@ -98,7 +138,7 @@ int main() {
                 cout << "Please enter the building type:" << endl;
                 cin >> buildingType;
 
-                DeleteBuildingFromColony(HEAD_COLONYNODE, buildingType, HEAD_CONSUMPTIONNODE, HEAD_STOCKNODE);
+                DeleteBuildingFromColony(COLONY, buildingType, journal);
 
 
                 break;
@@ -109,7 +149,7 @@ int main() {
                 cout << "CASE 3 INVOKED !" << endl;
                 #endif
 
-                PrintColony(HEAD_COLONYNODE);
+                PrintColony(COLONY.colonyHead);
 
                 break;
             case 4:
@@ -120,10 +160,7 @@ int main() {
                 cout << "CASE 4 INVOKED !" << endl;
                 #endif
 
-                cout << "(Reverse) Colony DLL:" << endl;
-                string tempStr;
-                PrintColonyReverse(HEAD_COLONYNODE,tempStr);
-                cout << tempStr << endl;
+                PrintColonyReverse(COLONY.colonyTail);
 
                 break;
                 }
@@ -134,7 +171,7 @@ int main() {
                 cout << "CASE 5 INVOKED !" << endl;
                 #endif
 
-                PrintColonyWithInnerEmptyBlocks(HEAD_COLONYNODE);
+                PrintColonyWithInnerEmptyBlocks(COLONY.colonyHead);
 
                 break;
             case 6:
@@ -144,7 +181,7 @@ int main() {
                 cout << "CASE 6 INVOKED !" << endl;
                 #endif
 
-                PrintColonyWithInnerEmptyBlocksREVERSE(HEAD_COLONYNODE);
+                PrintColonyWithInnerEmptyBlocksREVERSE(COLONY.colonyHead);
 
                 break;
             case 7:
@@ -154,7 +191,7 @@ int main() {
                 cout << "CASE 7 INVOKED !" << endl;
                 #endif
 
-                PrintStock(HEAD_STOCKNODE);
+                PrintStock(COLONY.stockHead);
 
                 break;
             case 8:
@@ -166,24 +203,87 @@ int main() {
 
                 cout << "Clearing the memory and terminating the program." << endl;
 
-                DeleteAll(HEAD_STOCKNODE);
-                DeleteAll(HEAD_CONSUMPTIONNODE);
-                DeleteAll(HEAD_COLONYNODE);
+                JournalClose(JOURNAL); // the last batch of records is synced before the memory goes
 
-                input_stockfile.close();
-                input_consumptionfile.close();
-                input_colonyfile.close();
+                ReleaseAll(COLONY.colonyHead); // the colony is the only colonyNode owner, its slabs go back in one step
+                ColonyStateFree(COLONY);
 
                 // break out of switch
                 running = false;
+                break;
+            case 9:
+                // Save the stock, consumption and colony DLLs into a binary snapshot
+
+                #ifdef DEBUG
+                cout << "CASE 9 INVOKED !" << endl;
+                #endif
+
+                SaveColonySnapshot(COLONY);
+
+                break;
+            case 10:
+                // Replace the colony with a binary snapshot
+
+                #ifdef DEBUG
+                cout << "CASE 10 INVOKED !" << endl;
+                #endif
+
+                LoadColonySnapshot(COLONY, journal);
+
+                break;
+            case 11:
+                // Write the stock and colony files with a checksum, the next start skips the resource checks
+
+                #ifdef DEBUG
+                cout << "CASE 11 INVOKED !" << endl;
+                #endif
+
+                SaveTrustedFiles(COLONY, journal);
+
+                break;
+            case 12:
+                // print what the colony as a whole consumes
+
+                #ifdef DEBUG
+                cout << "CASE 12 INVOKED !" << endl;
+                #endif
+
+                PrintTotalConsumption(COLONY);
+
+                break;
+            case 13:
+                // construct many buildings of one type at once
+
+                #ifdef DEBUG
+                cout << "CASE 13 INVOKED !" << endl;
+                #endif
+
+                ConstructManyBuildings(COLONY, journal);
+
+                break;
+            case 14:
+                // destroy the first buildings of a type (or all of them) at once
+
+                #ifdef DEBUG
+                cout << "CASE 14 INVOKED !" << endl;
+                #endif
+
+                DeleteManyBuildings(COLONY, journal);
+
+                break;
+            case 15:
+                // destroy the buildings of a block range at once
+
+                #ifdef DEBUG
+                cout << "CASE 15 INVOKED !" << endl;
+                #endif
+
+                DeleteBuildingRange(COLONY, journal);
+
                 break;
         }
 }
 
-    input_stockfile.close();
-    input_consumptionfile.close();
-    input_colonyfile.close();
-
     #ifdef DEBUG
     cout << "WARNING ! IF YOU SEE THIS IT MEANS THAT THE USER INPUTS HAVE BROKEN OUT OF THE MENU" << endl;
     cout << "WARNING ! IF YOU SEE THIS IT MEANS THAT THE USER INPUTS HAVE BROKEN OUT OF THE MENU" << endl;
@@ -0,0 +1,417 @@
+#include "mapped.h"
+#include "ledger.h"
+
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAVE_POSIX_MMAP
+#endif
+
+//#define DEBUG
+
+/* @brief Makes the bytes of a file available without going through iostreams.
+ *
+ * @param "filename" [in] Name of the file to be mapped.
+ *
+ * @param "file" [out] Receives the bytes, release with UnmapFile.
+ *
+ * @post Returns false if the file can not be opened.
+ *       The file is mmap'ed read only where POSIX mmap is available, otherwise (or if mapping fails, e.g. empty files)
+ *       it is read into file.buffer with plain read() calls.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+bool MapFile(const string& filename, mappedFile& file) {
+
+    UnmapFile(file);
+
+#if defined(HAVE_POSIX_MMAP)
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+
+        void* ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED) {
+
+            madvise(ptr, st.st_size, MADV_SEQUENTIAL); // single forward pass, let the kernel read ahead
+
+            file.data = (const char*)ptr;
+            file.size = st.st_size;
+            file.mapped = true;
+            close(fd);
+            return true;
+        }
+    }
+
+    // read() fallback
+    char chunk[1 << 16];
+    ssize_t got;
+    while ((got = read(fd, chunk, sizeof(chunk))) > 0) {
+        file.buffer.insert(file.buffer.end(), chunk, chunk + got);
+    }
+    close(fd);
+#else
+    ifstream in(filename.c_str(), ios::binary);
+    if (in.fail()) return false;
+
+    char chunk[1 << 16];
+    while (in.read(chunk, sizeof(chunk)) || in.gcount() > 0) {
+        file.buffer.insert(file.buffer.end(), chunk, chunk + in.gcount());
+    }
+#endif
+
+    file.data = file.buffer.data();
+    file.size = file.buffer.size();
+    file.mapped = false;
+    return true;
+}
+
+
+
+
+/* @brief Releases the bytes acquired by MapFile, safe to call on an empty mappedFile.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void UnmapFile(mappedFile& file) {
+
+#if defined(HAVE_POSIX_MMAP)
+    if (file.mapped) {
+        munmap((void*)file.data, file.size);
+    }
+#endif
+
+    file.data = NULL;
+    file.size = 0;
+    file.mapped = false;
+    file.buffer.clear();
+}
+
+
+
+
+/* @brief Helpers for the mapped parsers, they never allocate.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static const char* SkipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+static const char* LineEnd(const char* p, const char* end) {
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    return nl == NULL ? end : nl;
+}
+
+
+
+
+/* @brief Mapped counterpart of StockLoader, every "name quantity" line becomes a stock node.
+ *
+ * @param "file" [in] The mapped stock file.
+ *
+ * @param "head" / "tail" [in][out] Pointers of the stock DLL, updated as in StockLoader.
+ *
+ * @post Numbers are parsed with from_chars straight from the mapped bytes, blank lines and '#' lines are skipped.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+stockNode* StockLoaderMapped(const mappedFile& file, stockNode*& head, stockNode*& tail) {
+
+    const char* p = file.data;
+    const char* end = file.data + file.size;
+
+    while (p < end) {
+
+        const char* lineEnd = LineEnd(p, end);
+
+        const char* nameBegin = SkipSpaces(p, lineEnd);
+        const char* nameEnd = nameBegin;
+        while (nameEnd < lineEnd && *nameEnd != ' ' && *nameEnd != '\t' && *nameEnd != '\r') nameEnd++;
+
+        if (nameBegin != nameEnd && *nameBegin != '#') {
+
+            int quantity = 0;
+            const char* numBegin = SkipSpaces(nameEnd, lineEnd);
+            from_chars(numBegin, lineEnd, quantity);
+
+            StockAddToEnd(head, tail, string(nameBegin, nameEnd), quantity);
+        }
+
+        p = lineEnd + 1;
+    }
+
+    return head;
+}
+
+
+
+
+/* @brief Mapped counterpart of ConsumptionLoader, every "buildType q1 q2 ..." line becomes a consumption node.
+ *
+ * @param "file" [in] The mapped consumption file.
+ *
+ * @param "head" / "tail" [in][out] Pointers of the consumption DLL, updated as in ConsumptionLoader.
+ *
+ * @param "table" [in][out] Recipe table that gets filled alongside the DLL.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+consumpNode* ConsumptionLoaderMapped(const mappedFile& file, consumpNode*& head, consumpNode*& tail, consumpTable& table) {
+
+    const char* p = file.data;
+    const char* end = file.data + file.size;
+
+    vector<int> V; // reused for every line, ConsumptionAddToEnd keeps its own copy
+
+    while (p < end) {
+
+        const char* lineEnd = LineEnd(p, end);
+        const char* q = SkipSpaces(p, lineEnd);
+
+        if (q < lineEnd) {
+
+            char building = *q++;
+
+            V.clear();
+            while (true) {
+                q = SkipSpaces(q, lineEnd);
+
+                int quantity;
+                from_chars_result res = from_chars(q, lineEnd, quantity);
+                if (res.ec != errc()) break; // same place the stringstream extraction would stop
+
+                V.push_back(quantity);
+                q = res.ptr;
+            }
+
+            ConsumptionAddToEnd(head, tail, building, V, &table);
+        }
+
+        p = lineEnd + 1;
+    }
+
+    return head;
+}
+
+
+
+
+/* @brief Mapped counterpart of ColonyLoader, the whole mapped colony file is handed to ColonyParseBlock at once.
+ *
+ * @param "file" [in] The mapped colony file.
+ *
+ * @param "stats" [out] Optional, receives the amount of bytes and the time spent.
+ *
+ * @param "trustedHash" [in][out] Optional, only rebuild the structure and add it into the checksum, as in ColonyLoader.
+ *
+ * @post Same DLL, stock deductions and failure reporting as ColonyLoader.
+ *
+ * @see ColonyLoader
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyLoaderMapped(colonyNode*& head, colonyNode*& tail, stockNode* stockHead, const consumpTable& table, const mappedFile& file, colonyLoadStats* stats, unsigned long long* trustedHash) {
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    int emptyBlocks = 0;
+    stockNode* shortNode = NULL;
+    const char* bad = NULL;
+
+    if (trustedHash != NULL) {
+        long long block = 0;
+        ColonyParseBlockTrusted(file.data, file.data + file.size, emptyBlocks, head, tail, block, *trustedHash);
+    } else {
+        bad = ColonyParseBlock(file.data, file.data + file.size, emptyBlocks, head, tail, stockHead, table, shortNode);
+    }
+
+    if (bad != NULL) {
+        return ColonyLoadFailure(head, tail, bad, shortNode);
+    }
+
+    if (stats != NULL) {
+        stats->bytes = file.size;
+        stats->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    return colonyStatus(COLONY_OK);
+}
+
+
+
+
+// Byte histogram of one chunk of a colony file, filled by a worker of ColonyLoaderParallel
+struct colonyChunk{
+
+    const char* begin;
+    const char* end;
+    long long counts[256];
+
+    colonyChunk(const char* b = NULL, const char* e = NULL) : begin(b), end(e) {
+        memset(counts, 0, sizeof(counts));
+    }
+};
+
+
+
+
+/* @brief Counts every byte of a chunk, four interleaved histograms so that runs of the same character do not serialize
+ *        on one counter.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void CountChunk(colonyChunk& chunk) {
+
+    static thread_local long long partial[4][256];
+    memset(partial, 0, sizeof(partial));
+
+    const unsigned char* p = (const unsigned char*)chunk.begin;
+    const unsigned char* end = (const unsigned char*)chunk.end;
+
+    for (; end - p >= 4; p += 4) {
+        partial[0][p[0]]++;
+        partial[1][p[1]]++;
+        partial[2][p[2]]++;
+        partial[3][p[3]]++;
+    }
+    for (; p < end; p++) {
+        partial[0][*p]++;
+    }
+
+    for (int c = 0; c < 256; c++) {
+        chunk.counts[c] = partial[0][c] + partial[1][c] + partial[2][c] + partial[3][c];
+    }
+}
+
+
+
+
+/* @brief Multi-threaded counterpart of ColonyLoaderMapped.
+ *
+ * @param "file" [in] The mapped colony file.
+ *
+ * @param "threads" [in] Threads to use, 0 for one per hardware thread.
+ *
+ * @param "stats" [out] Optional, receives the amount of bytes and the time spent.
+ *
+ * @post Same DLL, stock deductions and failure reporting as ColonyLoader. The file is cut into chunks whose building
+ *       types are counted by worker threads while this thread builds the colony structure. The counts are then
+ *       multiplied by the recipes chunk by chunk in file order: with non negative recipes the stock only goes down, so
+ *       a chunk is affordable exactly when the demand up to its end leaves every resource its recipes mention non
+ *       negative. The first chunk that is not (or that holds an unknown building type) is replayed with
+ *       ColonyParseBlock from the stock before it, which finds the same building and resource ColonyLoader reports.
+ *       Recipes with negative amounts, small files and a single thread fall back to ColonyLoaderMapped.
+ *
+ * @see ColonyLoaderMapped
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonyLoaderParallel(colonyNode*& head, colonyNode*& tail, stockNode* stockHead, const consumpTable& table, const mappedFile& file, int threads, colonyLoadStats* stats) {
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    if (threads <= 0) threads = thread::hardware_concurrency();
+
+    stockLedger remaining;
+    recipeMatrix matrix;
+    LedgerFromStock(stockHead, remaining);
+    RecipeMatrixBuild(table, remaining, matrix);
+
+    bool negative = false;
+    for (int c = 0; c < 256; c++) {
+        const long long* recipe = RecipeRow(matrix, (char)c);
+        for (int i = 0; recipe != NULL && i < remaining.size; i++) {
+            if (recipe[i] < 0) negative = true;
+        }
+    }
+
+    if (negative || threads < 2 || file.size < COLONY_PARALLEL_MIN_SIZE) {
+        return ColonyLoaderMapped(head, tail, stockHead, table, file, stats);
+    }
+
+
+    // Count the chunks on the workers, build the structure here in the meantime
+    size_t chunkCount = (size_t)threads * 8;
+    size_t chunkSize = max((file.size + chunkCount - 1) / chunkCount, (size_t)COLONY_BLOCK_SIZE / 4);
+
+    vector<colonyChunk> chunks;
+    for (size_t offset = 0; offset < file.size; offset += chunkSize) {
+        chunks.push_back(colonyChunk(file.data + offset, file.data + min(offset + chunkSize, file.size)));
+    }
+
+    vector<thread> workers;
+    for (int w = 0; w < threads - 1; w++) {
+        workers.push_back(thread([&chunks, w, threads]() {
+            for (size_t c = w; c < chunks.size(); c += threads - 1) {
+                CountChunk(chunks[c]);
+            }
+        }));
+    }
+
+    int emptyBlocks = 0;
+    long long block = 0;
+    unsigned long long hash = 0;
+    ColonyParseBlockTrusted(file.data, file.data + file.size, emptyBlocks, head, tail, block, hash);
+
+    for (thread& worker : workers) {
+        worker.join();
+    }
+
+
+    // Check the chunks in file order
+    vector<char> listed(remaining.width, 0);
+    alignedQtys before;
+    size_t failing = chunks.size();
+
+    for (size_t c = 0; c < chunks.size() && failing == chunks.size(); c++) {
+
+        before = remaining.quantities;
+
+        for (int t = 0; t < 256; t++) {
+            long long count = chunks[c].counts[t];
+            if (count == 0 || t == '-' || t == '\n' || t == '\r') continue;
+
+            const long long* recipe = RecipeRow(matrix, (char)t);
+            if (recipe == NULL) {
+                failing = c;
+                break;
+            }
+
+            LedgerDeduct(remaining, recipe, count);
+            for (int i = 0; i < remaining.size; i++) {
+                if (recipe[remaining.width + i] != LLONG_MIN) listed[i] = 1;
+            }
+        }
+
+        for (int i = 0; i < remaining.size; i++) {
+            if (listed[i] && remaining.quantities[i] < 0) failing = c;
+        }
+    }
+
+    if (failing == chunks.size()) {
+        LedgerToStock(remaining, stockHead);
+
+        if (stats != NULL) {
+            stats->bytes = file.size;
+            stats->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+        return colonyStatus(COLONY_OK);
+    }
+
+
+    // Replay from the failing chunk with the stock it starts with
+    remaining.quantities = before;
+    LedgerToStock(remaining, stockHead);
+
+    colonyNode* replayHead = NULL;
+    colonyNode* replayTail = NULL;
+    stockNode* shortNode = NULL;
+    emptyBlocks = 0;
+    const char* bad = ColonyParseBlock(chunks[failing].begin, file.data + file.size, emptyBlocks, replayHead, replayTail, stockHead, table, shortNode);
+
+    if (bad == NULL) {
+        // Not reached: the replay deducted the rest of the file from the stock before it, which is a successful load
+        DeleteAll(replayHead);
+        return colonyStatus(COLONY_OK);
+    }
+
+    DeleteAll(head);
+    tail = NULL;
+
+    return ColonyLoadFailure(replayHead, replayTail, bad, shortNode);
+}
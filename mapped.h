@@ -0,0 +1,38 @@
+// Memory mapped input mode for the stock, consumption and colony files
+
+#ifndef _MAPPED_
+#define _MAPPED_
+
+#include <string>
+#include <vector>
+#include "functions.h"
+
+using namespace std;
+
+#define COLONY_PARALLEL_MIN_SIZE (4 << 20) // ColonyLoaderParallel loads smaller colony files serially
+
+// Struct definitions
+//------------------------------------------------------------------------------------------
+// Bytes of a whole input file, either mapped (POSIX mmap) or read into buffer when mapping is not possible
+struct mappedFile{
+
+    const char* data;
+    size_t size;
+
+    bool mapped;
+    vector<char> buffer;
+
+    mappedFile() : data(NULL), size(0), mapped(false) {}
+};
+//------------------------------------------------------------------------------------------
+//
+// Function prototypes
+//------------------------------------------------------------------------------------------
+bool MapFile(const string& filename, mappedFile& file);
+void UnmapFile(mappedFile& file);
+stockNode* StockLoaderMapped(const mappedFile& file, stockNode*& head, stockNode*& tail);
+consumpNode* ConsumptionLoaderMapped(const mappedFile& file, consumpNode*& head, consumpNode*& tail, consumpTable& table);
+colonyStatus ColonyLoaderMapped(colonyNode*& head, colonyNode*& tail, stockNode* stockHead, const consumpTable& table, const mappedFile& file, colonyLoadStats* stats = NULL, unsigned long long* trustedHash = NULL);
+colonyStatus ColonyLoaderParallel(colonyNode*& head, colonyNode*& tail, stockNode* stockHead, const consumpTable& table, const mappedFile& file, int threads = 0, colonyLoadStats* stats = NULL);
+//------------------------------------------------------------------------------------------
+#endif
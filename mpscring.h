@@ -0,0 +1,131 @@
+// Bounded lock-free multi-producer single-consumer ring, the command queue of a colony mutator thread
+
+#ifndef _MPSCRING_
+#define _MPSCRING_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+using namespace std;
+
+#define MPSCRING_CACHE_LINE 64
+
+/* @brief A fixed size ring of values handed from any number of producer threads to one consumer thread, without locks.
+ *
+ * @tparam Value What is queued, copied in and out (a pointer in practice).
+ *
+ * @note Every slot carries a sequence number that says whose turn it is. A producer claims a position with one CAS on
+ *       tail and releases the slot by storing position + 1 into its sequence, the consumer takes it and frees the slot
+ *       for the next lap by storing position + capacity. The consumer is the only one moving head, so it needs no CAS.
+ *       A slot that is claimed but not written yet ends the consumer's run, it is picked up on the next drain.
+ *
+ *       The consumer can sleep on an empty ring: it announces it in sleeping, looks at the ring once more and waits on
+ *       signal. The first producer that sees sleeping after its push clears it, bumps signal and wakes it up. Both sides put a full fence
+ *       between their store and their load, so at least one of them sees the other.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename Value>
+struct mpscRing{
+
+    struct slot{
+        atomic<size_t> sequence;
+        Value value;
+    };
+
+    unique_ptr<slot[]> slots;
+    size_t mask;                                                // capacity - 1, the capacity is a power of two
+
+    alignas(MPSCRING_CACHE_LINE) atomic<size_t> tail;           // next position a producer claims
+    alignas(MPSCRING_CACHE_LINE) size_t head;                   // next position the consumer takes, consumer only
+
+    alignas(MPSCRING_CACHE_LINE) atomic<bool> sleeping;         // the consumer is (about to be) waiting on signal
+    atomic<unsigned> signal;
+
+    explicit mpscRing(size_t capacity) : tail(0), head(0), sleeping(false), signal(0) {
+
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+
+        slots.reset(new slot[size]);
+        mask = size - 1;
+
+        for (size_t i = 0; i < size; i++) {
+            slots[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
+
+    // Queues a value, false if the ring is full
+    bool tryPush(const Value& value) {
+
+        size_t position = tail.load(memory_order_relaxed);
+
+        for (;;) {
+            slot& s = slots[position & mask];
+            intptr_t turn = (intptr_t)s.sequence.load(memory_order_acquire) - (intptr_t)position;
+
+            if (turn == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                    s.value = value;
+                    s.sequence.store(position + 1, memory_order_release);
+                    return true;
+                }
+            } else if (turn < 0) {
+                return false;                                   // the consumer is a whole lap behind
+            } else {
+                position = tail.load(memory_order_relaxed);     // another producer took this position
+            }
+        }
+    }
+
+    // Queues a value, yields while the ring is full, then wakes the consumer if it sleeps
+    void push(const Value& value) {
+
+        while (!tryPush(value)) {
+            this_thread::yield();
+        }
+
+        // The value must be visible before sleeping is read (waitForWork does the opposite). Only the producer that
+        // clears sleeping pays for the wake-up call, the others see the consumer as awake already.
+        atomic_thread_fence(memory_order_seq_cst);
+        if (sleeping.load() && sleeping.exchange(false)) {
+            signal.fetch_add(1);
+            signal.notify_one();
+        }
+    }
+
+    // Consumer only: takes up to max values in queue order, returns how many
+    size_t popMany(Value* out, size_t max) {
+
+        size_t taken = 0;
+
+        while (taken < max) {
+            slot& s = slots[head & mask];
+            if (s.sequence.load(memory_order_acquire) != head + 1) break;
+
+            out[taken++] = s.value;
+            s.sequence.store(head + mask + 1, memory_order_release);
+            head++;
+        }
+        return taken;
+    }
+
+    // Consumer only: true if the next value is ready
+    bool ready() const {
+        return slots[head & mask].sequence.load(memory_order_acquire) == head + 1;
+    }
+
+    // Consumer only: blocks until a value is ready (it may also return early, callers loop)
+    void waitForWork() {
+
+        unsigned seen = signal.load();
+        sleeping.store(true);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        if (!ready()) signal.wait(seen);
+
+        sleeping.store(false);
+    }
+};
+#endif
@@ -0,0 +1,157 @@
+// Slab allocator backing the stock, consumption and colony nodes
+
+#ifndef _NODEPOOL_
+#define _NODEPOOL_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+#define NODEPOOL_SLAB_BYTES (1 << 16)   // every slab is this many bytes, aligned to its own size
+
+/* @brief Hands out Node sized blocks carved from large slabs, freed blocks go to an intrusive free list.
+ *
+ * @tparam Node The node type (stockNode/consumpNode/colonyNode), its class operator new/delete call into the pool.
+ *
+ * @note Every thread allocates from its own pool (local()), so there is no locking on the hot path. Every slab starts
+ *       with the pool it belongs to, found by rounding a block down to the slab alignment. A block freed on its own
+ *       thread goes onto the free list directly, a block freed on another thread is pushed onto the remote list of its
+ *       pool (lock-free) and taken over by the owning thread when its free list runs dry. No free list ever points
+ *       into the slabs of another pool.
+ *
+ *       When its thread ends a pool is deleted together with its slabs as soon as no block of it is alive any more,
+ *       right away or by the remote free of its last block.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+template <typename Node>
+struct nodePool{
+
+    struct freeSlot{
+        freeSlot* next;
+    };
+
+    static const size_t slotSize = sizeof(Node) < sizeof(freeSlot) ? sizeof(freeSlot) : sizeof(Node);
+    static const size_t slabHeader = alignof(max_align_t) > sizeof(nodePool*) ? alignof(max_align_t) : sizeof(nodePool*);
+
+    vector<char*> slabs;
+    freeSlot* freeList;
+
+    char* bump;      // next never used block of the newest slab
+    char* bumpEnd;
+
+    long long live;                 // blocks handed out minus blocks freed on the owning thread
+    atomic<freeSlot*> remoteList;   // blocks freed on other threads, not taken over yet
+    atomic<long long> remoteFreed;  // minus the blocks freed on other threads, plus live once the thread has ended
+
+    nodePool() : freeList(NULL), bump(NULL), bumpEnd(NULL), live(0), remoteList(NULL), remoteFreed(0) {}
+
+    ~nodePool() {
+        for (size_t i = 0; i < slabs.size(); i++) {
+            ::operator delete(slabs[i], align_val_t(NODEPOOL_SLAB_BYTES));
+        }
+    }
+
+    void* allocate() {
+
+        live++;
+
+        if (freeList == NULL) {
+            freeList = remoteList.exchange(NULL, memory_order_acquire);
+        }
+
+        if (freeList != NULL) {
+            freeSlot* slot = freeList;
+            freeList = slot->next;
+            return slot;
+        }
+
+        if ((size_t)(bumpEnd - bump) < slotSize) {
+            char* slab = (char*)::operator new(NODEPOOL_SLAB_BYTES, align_val_t(NODEPOOL_SLAB_BYTES));
+            *(nodePool**)slab = this;
+            slabs.push_back(slab);
+            bump = slab + slabHeader;
+            bumpEnd = slab + NODEPOOL_SLAB_BYTES;
+        }
+
+        void* block = bump;
+        bump += slotSize;
+        return block;
+    }
+
+    // The pool a block was carved from, stored at the start of its slab
+    static nodePool* owner(void* block) {
+        return *(nodePool**)((uintptr_t)block & ~(uintptr_t)(NODEPOOL_SLAB_BYTES - 1));
+    }
+
+    static void deallocate(void* block) {
+
+        nodePool* pool = owner(block);
+        freeSlot* slot = (freeSlot*)block;
+
+        if (pool == current()) {
+            pool->live--;
+            slot->next = pool->freeList;
+            pool->freeList = slot;
+            return;
+        }
+
+        slot->next = pool->remoteList.load(memory_order_relaxed);
+        while (!pool->remoteList.compare_exchange_weak(slot->next, slot, memory_order_release, memory_order_relaxed)) {}
+
+        // The count only reaches 0 from above once the owning thread has ended (retire), the last free deletes the pool
+        if (pool->remoteFreed.fetch_sub(1, memory_order_acq_rel) == 1) delete pool;
+    }
+
+    /* Gives every slab back at once, all nodes carved from this pool become invalid.
+     * @pre Called on the owning thread, and no other thread holds or is freeing a node of this pool. */
+    void release() {
+
+        for (size_t i = 0; i < slabs.size(); i++) {
+            ::operator delete(slabs[i], align_val_t(NODEPOOL_SLAB_BYTES));
+        }
+        slabs.clear();
+
+        freeList = NULL;
+        bump = bumpEnd = NULL;
+        live = 0;
+        remoteList.store(NULL, memory_order_relaxed);
+        remoteFreed.store(0, memory_order_relaxed);
+    }
+
+    // Called when the owning thread ends: the pool goes now if nothing of it is alive, otherwise with its last block
+    void retire() {
+
+        if (remoteFreed.fetch_add(live, memory_order_acq_rel) + live == 0) delete this;
+    }
+
+    // The pool of the calling thread, NULL before its first allocation and after the thread has ended. A plain pointer,
+    // so it can still be read by frees that run during thread exit.
+    static nodePool*& current() {
+        static thread_local nodePool* pool = NULL;
+        return pool;
+    }
+
+    struct threadExit{
+        ~threadExit() {
+            nodePool* pool = current();
+            current() = NULL;
+            if (pool != NULL) pool->retire();
+        }
+    };
+
+    static nodePool& local() {
+
+        nodePool*& pool = current();
+        if (pool == NULL) {
+            static thread_local threadExit onExit;
+            (void)onExit;
+            pool = new nodePool();
+        }
+        return *pool;
+    }
+};
+
+#endif
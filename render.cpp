@@ -0,0 +1,166 @@
+#include "render.h"
+
+#include <charconv>
+#include <cstring>
+
+//#define DEBUG
+
+/* @brief Number of characters to_chars produces for a value.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static size_t DigitCount(long long value) {
+
+    size_t digits = value < 0 ? 2 : 1;
+    if (value < 0) value = -value;
+
+    while (value >= 10) {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+
+
+
+/* @brief Building types of the colony without the empty blocks ("ZeGVKM").
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+size_t BuildingTypesLength(colonyNode* head) {
+
+    size_t length = 0;
+    for (colonyNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+        length++;
+    }
+    return length;
+}
+
+char* RenderBuildingTypes(colonyNode* head, char* out) {
+
+    for (colonyNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+        *out++ = ptr->buildType;
+    }
+    return out;
+}
+
+
+
+
+/* @brief The colony with its inner empty blocks ("----Ze-G-VKM"), dash runs are filled with memset.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+size_t DecodedColonyLength(colonyNode* head) {
+
+    size_t length = 0;
+    for (colonyNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+        length += ptr->emptyBlocks2TheLeft + 1;
+    }
+    return length;
+}
+
+char* RenderDecodedColony(colonyNode* head, char* out) {
+
+    for (colonyNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+        memset(out, '-', ptr->emptyBlocks2TheLeft);
+        out += ptr->emptyBlocks2TheLeft;
+        *out++ = ptr->buildType;
+    }
+    return out;
+}
+
+
+
+
+/* @brief The blocks [first, end) of the decoded colony, end - first characters (dashes past the last building).
+ *
+ * @param "node" [in] First building at or after block first (ColonyIndexFindBlock), NULL if there is none.
+ *
+ * @param "nodeBlock" [in] Block of node.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+char* RenderColonyBlocks(colonyNode* node, long long nodeBlock, long long first, long long end, char* out) {
+
+    while (node != NULL && nodeBlock < end) {
+        memset(out, '-', nodeBlock - first);
+        out += nodeBlock - first;
+        *out++ = node->buildType;
+
+        first = nodeBlock + 1;
+        node = node->next;
+        if (node != NULL) nodeBlock += node->emptyBlocks2TheLeft + 1;
+    }
+
+    memset(out, '-', end - first);
+    return out + (end - first);
+}
+
+
+
+
+/* @brief The run-length form of the colony ("(4)Z(0)e(1)G").
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+size_t EncodedColonyLength(colonyNode* head) {
+
+    size_t length = 0;
+    for (colonyNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+        length += DigitCount(ptr->emptyBlocks2TheLeft) + 3;
+    }
+    return length;
+}
+
+char* RenderEncodedColony(colonyNode* head, char* out) {
+
+    for (colonyNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+        *out++ = '(';
+        out = to_chars(out, out + 24, ptr->emptyBlocks2TheLeft).ptr;
+        *out++ = ')';
+        *out++ = ptr->buildType;
+    }
+    return out;
+}
+
+
+
+
+/* @brief One "name(quantity)" line per stock node.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+size_t StockLength(stockNode* head) {
+
+    size_t length = 0;
+    for (stockNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+        length += ptr->resourceName.size() + DigitCount(ptr->resourceQuantity) + 3;
+    }
+    return length;
+}
+
+char* RenderStock(stockNode* head, char* out) {
+
+    for (stockNode* ptr = head; ptr != NULL; ptr = ptr->next) {
+        memcpy(out, ptr->resourceName.data(), ptr->resourceName.size());
+        out += ptr->resourceName.size();
+        *out++ = '(';
+        out = to_chars(out, out + 24, ptr->resourceQuantity).ptr;
+        *out++ = ')';
+        *out++ = '\n';
+    }
+    return out;
+}
+
+
+
+
+/* @brief Copies a fixed piece of text (headers, line breaks) into the buffer.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+char* RenderText(const char* text, char* out) {
+
+    size_t length = strlen(text);
+    memcpy(out, text, length);
+    return out + length;
+}
+
+
+
+
+/* @brief Writes a rendered buffer to the console with a single write and flushes it (the old printers ended with endl).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void EmitBuffer(const string& buffer) {
+
+    cout.write(buffer.data(), buffer.size());
+    cout.flush();
+}
@@ -0,0 +1,26 @@
+// Buffered rendering of the colony and stock DLLs, shared by the Print* functions
+
+#ifndef _RENDER_
+#define _RENDER_
+
+#include <string>
+#include "functions.h"
+
+using namespace std;
+
+// Every Render* function writes exactly the amount of characters its *Length counterpart reports and returns the end of
+// what it has written, so a printer can size one buffer up front, fill it and emit it with a single write.
+//------------------------------------------------------------------------------------------
+size_t BuildingTypesLength(colonyNode* head);
+char* RenderBuildingTypes(colonyNode* head, char* out);
+size_t DecodedColonyLength(colonyNode* head);
+char* RenderDecodedColony(colonyNode* head, char* out);
+char* RenderColonyBlocks(colonyNode* node, long long nodeBlock, long long first, long long end, char* out);
+size_t EncodedColonyLength(colonyNode* head);
+char* RenderEncodedColony(colonyNode* head, char* out);
+size_t StockLength(stockNode* head);
+char* RenderStock(stockNode* head, char* out);
+char* RenderText(const char* text, char* out);
+void EmitBuffer(const string& buffer);
+//------------------------------------------------------------------------------------------
+#endif
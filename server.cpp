@@ -0,0 +1,551 @@
+#include "server.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//#define DEBUG
+
+// The commands of the protocol, with their word count (the command itself included)
+struct serverCommand{
+
+    const char* name;
+    size_t words;
+    const char* usage;
+};
+
+static const serverCommand serverCommands[] = {
+    {"LOAD", 5, "LOAD <id> <stock file> <consumption file> <colony file>"},
+    {"OPEN", 3, "OPEN <id> <snapshot file>"},
+    {"SAVE", 3, "SAVE <id> <snapshot file>"},
+    {"CONSTRUCT", 4, "CONSTRUCT <id> <buildType> <empty block number>"},
+    {"DESTROY", 3, "DESTROY <id> <buildType>"},
+    {"COLONY", 2, "COLONY <id>"},
+    {"STOCK", 2, "STOCK <id>"},
+    {"UNLOAD", 2, "UNLOAD <id>"}
+};
+
+
+
+
+/* @brief Splits a command line into its words, separated by spaces, tabs and carriage returns.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void SplitWords(const string& line, vector<string>& words) {
+
+    size_t i = 0;
+    while (i < line.size()) {
+
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) i++;
+
+        size_t start = i;
+        while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') i++;
+
+        if (i > start) words.push_back(line.substr(start, i - start));
+    }
+}
+
+
+
+
+/* @brief One line description of a failed colony call, in the words of the menu.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static string StatusMessage(const colonyStatus& status) {
+
+    switch (status.result) {
+        case COLONY_UNKNOWN_TYPE:   return string("Building type ") + status.buildType + " is not found in the consumption DLL.";
+        case COLONY_BAD_INDEX:      return "Empty block numbers start from 1.";
+        case COLONY_INSUFFICIENT:   return "Insufficient resource " + status.detail;
+        case COLONY_NOT_FOUND:      return string("Building of type ") + status.buildType + " not found in the colony.";
+        case COLONY_OPEN_FAILED:    return "Unable to open the file " + status.detail + ".";
+        case COLONY_BAD_SNAPSHOT:   return "The file " + status.detail + " is not a valid colony snapshot.";
+        default:                    return "Failed.";
+    }
+}
+
+
+
+
+/* @brief The reply to a colony call: "OK" or "ERR <message>".
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static string StatusReply(const colonyStatus& status) {
+
+    return status.result == COLONY_OK ? "OK" : "ERR " + StatusMessage(status);
+}
+
+
+
+
+/* @brief Adds a colony to the published directory of a shard, or takes it out (publisher NULL).
+ *
+ * @post Readers holding the previous directory keep using it, a colony they still find there stays readable
+ *       through its last view.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void DirectoryUpdate(colonyShard& shard, const string& id, shared_ptr<colonyPublisher> publisher) {
+
+    shared_ptr<colonyDirectory> directory = make_shared<colonyDirectory>(*atomic_load_explicit(&shard.directory, memory_order_acquire));
+
+    if (publisher != NULL) {
+        (*directory)[id] = publisher;
+    } else {
+        directory->erase(id);
+    }
+
+    atomic_store_explicit(&shard.directory, shared_ptr<const colonyDirectory>(move(directory)), memory_order_release);
+}
+
+
+
+
+/* @brief Answers COLONY and STOCK from the published view of the colony, on the calling thread.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static string ServeQuery(const colonyShard& shard, const vector<string>& words) {
+
+    shared_ptr<const colonyDirectory> directory = atomic_load_explicit(&shard.directory, memory_order_acquire);
+
+    colonyDirectory::const_iterator found = directory->find(words[1]);
+    if (found == directory->end()) return "ERR Colony " + words[1] + " is not loaded.";
+
+    shared_ptr<const colonyView> view = ColonyViewAcquire(*found->second);
+
+    if (words[0] == "COLONY") {
+
+        string buffer(ViewColonyLength(*view) + 3, ' ');
+        buffer[0] = 'O';
+        buffer[1] = 'K';
+        RenderViewColony(*view, &buffer[3]);
+
+        if (buffer.size() == 3) buffer.resize(2);
+        return buffer;
+    }
+
+    // One "name(quantity)" per line from RenderViewStock, put on a single line
+    string buffer(ViewStockLength(*view) + 3, ' ');
+    buffer[0] = 'O';
+    buffer[1] = 'K';
+    RenderViewStock(*view, &buffer[3]);
+
+    for (size_t i = 3; i < buffer.size(); i++) {
+        if (buffer[i] == '\n') buffer[i] = ' ';
+    }
+    buffer.resize(buffer.size() - 1);
+    return buffer;
+}
+
+
+
+
+/* @brief Runs one command against the colonies of a shard, on the worker thread of the shard.
+ *
+ * @param "words" [in] The command, already checked against serverCommands for its word count. Not a query.
+ *
+ * @return The reply line, without its newline.
+ *
+ * @post A loaded colony is published in the directory of the shard with its first view, an unloaded one is taken out.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static string ShardExecute(colonyShard& shard, const vector<string>& words) {
+
+    const string& command = words[0];
+    const string& id = words[1];
+
+    if (command == "LOAD" || command == "OPEN") {
+
+        if (shard.colonies.count(id) != 0) return "ERR Colony " + id + " is already loaded.";
+
+        colonyState& state = shard.colonies[id];
+        colonyStatus status = command == "LOAD" ? ColonyStateLoad(state, words[2], words[3], words[4]) : ColonySnapshotLoad(state, words[2]);
+
+        // Both loaders leave the state empty on failure
+        if (status.result != COLONY_OK) {
+            shard.colonies.erase(id);
+        } else {
+            shared_ptr<colonyPublisher> publisher = make_shared<colonyPublisher>();
+            ColonyPublish(state, *publisher);
+            DirectoryUpdate(shard, id, publisher);
+        }
+
+        return StatusReply(status);
+    }
+
+    unordered_map<string, colonyState>::iterator found = shard.colonies.find(id);
+    if (found == shard.colonies.end()) return "ERR Colony " + id + " is not loaded.";
+
+    colonyState& state = found->second;
+
+    if (command == "CONSTRUCT" || command == "DESTROY") {
+
+        if (words[2].size() != 1) return "ERR Building types are a single character.";
+        char buildType = words[2][0];
+
+        if (command == "DESTROY") return StatusReply(ColonyDestroy(state, buildType));
+
+        long long index;
+        const char* end = words[3].data() + words[3].size();
+        from_chars_result res = from_chars(words[3].data(), end, index);
+
+        if (res.ec != errc() || res.ptr != end || index > INT_MAX) return "ERR Invalid empty block number " + words[3];
+
+        return StatusReply(ColonyConstruct(state, buildType, index < 1 ? 0 : (int)index));
+    }
+
+    if (command == "SAVE") {
+        return StatusReply(ColonySnapshotSave(state, words[2]));
+    }
+
+    // UNLOAD
+    DirectoryUpdate(shard, id, NULL);
+    ColonyStateFree(state);
+    shard.colonies.erase(found);
+    return "OK";
+}
+
+
+
+
+/* @brief Worker thread of a shard, the only thread that changes its colonies. Runs the queued commands in arrival
+ *        order until it takes the NULL job of ServerStop. Everything ready in the queue (up to SERVER_BATCH_MAX
+ *        commands) is taken in one drain and run as one batch.
+ *
+ * @post The colonies still loaded are freed on this thread and its node pools give their slabs back, as no node of
+ *       this thread is alive any more.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void ShardWorker(colonyShard* shard) {
+
+    vector<serverJob*> batch(SERVER_BATCH_MAX);
+    vector<string> replies, changed;
+    bool stopping = false;
+
+    while (!stopping) {
+
+        size_t taken = shard->jobs.popMany(batch.data(), SERVER_BATCH_MAX);
+        if (taken == 0) {
+            shard->jobs.waitForWork();
+            continue;
+        }
+
+        // Nothing is queued behind the stop request
+        if (batch[taken - 1] == NULL) {
+            stopping = true;
+            taken--;
+        }
+        batch.resize(taken);
+
+        for (serverJob* job : batch) {
+
+            replies.push_back(ShardExecute(*shard, job->words));
+
+            const string& command = job->words[0];
+            if ((command == "CONSTRUCT" || command == "DESTROY") && replies.back() == "OK") changed.push_back(job->words[1]);
+        }
+
+        // One new view per changed colony for the whole batch, published before any of its replies goes out so that a
+        // client always sees its own change
+        sort(changed.begin(), changed.end());
+        changed.erase(unique(changed.begin(), changed.end()), changed.end());
+
+        shared_ptr<const colonyDirectory> directory = atomic_load_explicit(&shard->directory, memory_order_acquire);
+        for (const string& id : changed) {
+
+            colonyDirectory::const_iterator published = directory->find(id);
+            if (published != directory->end()) ColonyPublish(shard->colonies[id], *published->second);
+        }
+
+        for (size_t i = 0; i < batch.size(); i++) {
+
+            // The promise is moved out first: the job lives on the stack of the waiting thread and may be gone as soon as
+            // the reply is set
+            promise<string> reply = move(batch[i]->reply);
+            reply.set_value(move(replies[i]));
+        }
+        batch.resize(SERVER_BATCH_MAX);
+        replies.clear();
+        changed.clear();
+    }
+
+    for (auto& entry : shard->colonies) {
+        ColonyStateFree(entry.second);
+    }
+    shard->colonies.clear();
+
+    nodePool<stockNode>::local().release();
+    nodePool<consumpNode>::local().release();
+    nodePool<colonyNode>::local().release();
+}
+
+
+
+
+/* @brief Starts the worker pool of a server, without a socket (ServerListen), so it can also be driven in-process
+ *        through ServerExecute.
+ *
+ * @param "workers" [in] Number of shards, each with one worker thread, at least 1.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ServerStart(colonyServer& server, int workers) {
+
+    server.stopping = false;
+
+    for (int i = 0; i < max(workers, 1); i++) {
+        colonyShard* shard = new colonyShard();
+        shard->worker = thread(ShardWorker, shard);
+        server.shards.push_back(shard);
+    }
+
+    #ifdef DEBUG
+    cout << "DEBUG: SERVER STARTED WITH " << server.shards.size() << " WORKERS" << endl;
+    #endif
+}
+
+
+
+
+/* @brief Opens the Unix domain socket the clients connect to.
+ *
+ * @param "socketPath" [in] Path of the socket. A socket left there by a server that is gone is replaced, a path
+ *                          that is in use (or is not a socket) is not touched.
+ *
+ * @return false if the socket can not be created.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+bool ServerListen(colonyServer& server, const string& socketPath) {
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) return false;
+    memcpy(address.sun_path, socketPath.data(), socketPath.size());
+
+    struct stat info;
+    if (lstat(socketPath.c_str(), &info) == 0) {
+
+        if (!S_ISSOCK(info.st_mode)) return false;
+
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool alive = probe >= 0 && connect(probe, (sockaddr*)&address, sizeof(address)) == 0;
+        if (probe >= 0) close(probe);
+
+        if (alive) return false;
+        unlink(socketPath.c_str());
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return false;
+    }
+
+    server.listenFd = fd;
+    server.socketPath = socketPath;
+    return true;
+}
+
+
+
+
+/* @brief Writes all of a buffer to a socket.
+ *
+ * @return false if the client has gone away.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static bool SendAll(int fd, const string& bytes) {
+
+    size_t sent = 0;
+    while (sent < bytes.size()) {
+
+        ssize_t n = send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+
+        sent += n;
+    }
+    return true;
+}
+
+
+
+
+/* @brief Reads the commands of one client until it disconnects, every line is answered by one line.
+ *
+ * @post The replies to all the complete lines of one read go back in a single write, so a client that pipelines its
+ *       commands pays one system call per batch instead of one per command.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void ServeConnection(colonyServer* server, serverConnection* connection) {
+
+    int fd = connection->fd;
+    string buffer, replies;
+    char chunk[4096];
+
+    for (;;) {
+
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        buffer.append(chunk, n);
+
+        size_t start = 0, newline;
+        while ((newline = buffer.find('\n', start)) != string::npos) {
+            replies += ServerExecute(*server, buffer.substr(start, newline - start));
+            replies += '\n';
+            start = newline + 1;
+        }
+        buffer.erase(0, start);
+
+        bool tooLong = buffer.size() > SERVER_MAX_LINE;
+        if (tooLong) replies += "ERR Command line too long.\n";
+
+        if (!SendAll(fd, replies) || tooLong) break;
+        replies.clear();
+    }
+
+    lock_guard<mutex> guard(server->connectionsLock);
+    close(fd);
+    connection->fd = -1;
+    connection->finished = true;
+}
+
+
+
+
+/* @brief Joins the threads of the clients that have disconnected.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void ReapConnections(colonyServer& server) {
+
+    list<serverConnection*>::iterator it = server.connections.begin();
+    while (it != server.connections.end()) {
+
+        if ((*it)->finished) {
+            (*it)->handler.join();
+            delete *it;
+            it = server.connections.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+
+
+/* @brief Accepts clients until the server is stopped (a SHUTDOWN command, or the stopping flag set by a signal handler),
+ *        each client gets a thread of its own.
+ *
+ * @pre ServerStart and ServerListen have been called.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ServerRun(colonyServer& server) {
+
+    while (!server.stopping) {
+
+        pollfd listener = {server.listenFd, POLLIN, 0};
+        int ready = poll(&listener, 1, SERVER_POLL_MS);
+
+        ReapConnections(server);
+        if (ready <= 0) continue;
+
+        int fd = accept(server.listenFd, NULL, NULL);
+        if (fd < 0) continue;
+
+        serverConnection* connection = new serverConnection();
+        connection->fd = fd;
+        server.connections.push_back(connection);
+        connection->handler = thread(ServeConnection, &server, connection);
+
+        #ifdef DEBUG
+        cout << "DEBUG: CLIENT CONNECTED, " << server.connections.size() << " OPEN" << endl;
+        #endif
+    }
+}
+
+
+
+
+/* @brief Runs one command line on the shard that owns its colony and waits for the reply.
+ *
+ * @param "line" [in] One line of the protocol (server.h), without its newline.
+ *
+ * @return The reply line, without its newline.
+ *
+ * @post The command is queued on the lock-free ring of the shard (mpscring.h), the caller waits on its own future.
+ *       A full ring makes the caller wait for room.
+ *
+ * @note Thread safe. Commands from one caller run in the order they are given, commands on colonies of different
+ *       shards run in parallel. The shard is the colony id hashed modulo the number of workers. Queries are answered
+ *       right here from the published views, in parallel with everything else.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+string ServerExecute(colonyServer& server, const string& line) {
+
+    serverJob job;
+    SplitWords(line, job.words);
+
+    if (job.words.empty()) return "ERR Empty command.";
+
+    if (job.words[0] == "SHUTDOWN" && job.words.size() == 1) {
+        server.stopping = true;
+        return "OK";
+    }
+
+    const serverCommand* command = NULL;
+    for (const serverCommand& known : serverCommands) {
+        if (job.words[0] == known.name) command = &known;
+    }
+
+    if (command == NULL) return "ERR Unknown command " + job.words[0] + ".";
+    if (job.words.size() != command->words) return string("ERR Usage: ") + command->usage;
+
+    colonyShard* shard = server.shards[hash<string>()(job.words[1]) % server.shards.size()];
+
+    if (job.words[0] == "COLONY" || job.words[0] == "STOCK") return ServeQuery(*shard, job.words);
+
+    future<string> reply = job.reply.get_future();
+    shard->jobs.push(&job);
+
+    return reply.get();
+}
+
+
+
+
+/* @brief Stops the server: no more clients, the open connections are cut, then every shard runs what it has queued
+ *        and frees its colonies.
+ *
+ * @pre No thread of the caller is still in ServerExecute (the connection threads are joined here first).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+void ServerStop(colonyServer& server) {
+
+    server.stopping = true;
+
+    if (server.listenFd >= 0) {
+        close(server.listenFd);
+        unlink(server.socketPath.c_str());
+        server.listenFd = -1;
+    }
+
+    // A blocked read returns 0 once its socket is shut down, the handler then closes it
+    {
+        lock_guard<mutex> guard(server.connectionsLock);
+        for (serverConnection* connection : server.connections) {
+            if (connection->fd >= 0) shutdown(connection->fd, SHUT_RDWR);
+        }
+    }
+    for (serverConnection* connection : server.connections) {
+        connection->handler.join();
+        delete connection;
+    }
+    server.connections.clear();
+
+    for (colonyShard* shard : server.shards) {
+        shard->jobs.push(NULL);
+    }
+    for (colonyShard* shard : server.shards) {
+        shard->worker.join();
+        delete shard;
+    }
+    server.shards.clear();
+}
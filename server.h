@@ -0,0 +1,102 @@
+// Multi-colony server: one process hosts many colonies, sharded over a fixed pool of worker threads by colony id and
+// driven by text commands over a local Unix domain socket
+
+#ifndef _SERVER_
+#define _SERVER_
+
+#include <atomic>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "colony.h"
+#include "colonyview.h"
+#include "mpscring.h"
+
+using namespace std;
+
+// The protocol is one command per line, answered by one line: "OK", "OK <result>" or "ERR <message>".
+// A colony id is any word, the files are read and written by the server process.
+//
+//   LOAD <id> <stock file> <consumption file> <colony file>     a new colony from its three files (ColonyStateLoad)
+//   OPEN <id> <snapshot file>                                    a new colony from a snapshot
+//   SAVE <id> <snapshot file>                                    snapshot of a colony
+//   CONSTRUCT <id> <buildType> <empty block number>
+//   DESTROY <id> <buildType>
+//   COLONY <id>                                                  the colony with its inner empty blocks (*)
+//   STOCK <id>                                                   "name(quantity) name(quantity) ..." (*)
+//   UNLOAD <id>                                                  frees the colony
+//   SHUTDOWN                                                     stops the server
+//
+// (*) Queries do not go through the worker, they read the colonyView (colonyview.h) the worker published after the
+//     last batch of commands that changed the colony, so they never wait behind a construct or a load.
+//------------------------------------------------------------------------------------------
+#define SERVER_DEFAULT_WORKERS 4
+#define SERVER_QUEUE_CAPACITY 1024  // commands queued per shard before a caller has to wait for room
+#define SERVER_BATCH_MAX 256        // commands a worker takes from its queue at once
+#define SERVER_MAX_LINE 4096        // longest command line a connection may send
+#define SERVER_POLL_MS 200          // how often the accept loop looks at the stopping flag
+//------------------------------------------------------------------------------------------
+//
+// Struct definitions
+//------------------------------------------------------------------------------------------
+// A command on its way to the worker that owns its colony
+struct serverJob{
+
+    vector<string> words;
+    promise<string> reply;
+};
+
+// The published colonies of a shard by id. Replaced as a whole (copy, change, publish) on LOAD, OPEN and UNLOAD only.
+typedef unordered_map<string, shared_ptr<colonyPublisher>> colonyDirectory;
+
+// One worker thread and the colonies it owns. Colonies are created, changed and freed on their worker only, so their
+// nodes all come from (and go back to) that thread's node pools and no colony needs a lock of its own.
+struct colonyShard{
+
+    mpscRing<serverJob*> jobs;  // any thread pushes, the worker drains, NULL asks the worker to stop
+    thread worker;
+
+    unordered_map<string, colonyState> colonies;    // touched by the worker only
+    shared_ptr<const colonyDirectory> directory;    // written by the worker, read by the queries (atomic_load / atomic_store)
+
+    colonyShard() : jobs(SERVER_QUEUE_CAPACITY), directory(make_shared<const colonyDirectory>()) {}
+};
+
+// A client socket and the thread reading its commands
+struct serverConnection{
+
+    int fd;
+    thread handler;
+    atomic<bool> finished;
+
+    serverConnection() : fd(-1), finished(false) {}
+};
+
+struct colonyServer{
+
+    vector<colonyShard*> shards;
+    atomic<bool> stopping;
+
+    string socketPath;
+    int listenFd;
+
+    mutex connectionsLock;                  // guards the fd of every connection
+    list<serverConnection*> connections;    // touched by the accept loop only, apart from the fds
+
+    colonyServer() : stopping(false), listenFd(-1) {}
+};
+//------------------------------------------------------------------------------------------
+//
+// Function prototypes
+//------------------------------------------------------------------------------------------
+void ServerStart(colonyServer& server, int workers);
+bool ServerListen(colonyServer& server, const string& socketPath);
+void ServerRun(colonyServer& server);
+string ServerExecute(colonyServer& server, const string& line);
+void ServerStop(colonyServer& server);
+//------------------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,54 @@
+#include <iostream>
+#include <string>
+#include <csignal>
+#include <cstdlib>
+#include "server.h"
+
+//#define DEBUG
+
+using namespace std;
+
+// Set by SIGINT / SIGTERM, ServerRun looks at it between two polls of the socket
+static atomic<bool>* stopFlag = NULL;
+
+static void StopOnSignal(int) {
+    if (stopFlag != NULL) stopFlag->store(true);
+}
+
+int main(int argc, char* argv[]) {
+
+    // usage: colony_server <socket path> [--workers N]
+    //   --workers  worker threads the colonies are sharded over (default SERVER_DEFAULT_WORKERS)
+    if (argc != 2 && !(argc == 4 && string(argv[2]) == "--workers")) {
+        cout << "usage: colony_server <socket path> [--workers N]" << endl;
+        return 1;
+    }
+
+    int workers = argc == 4 ? atoi(argv[3]) : SERVER_DEFAULT_WORKERS;
+    if (workers < 1) {
+        cout << "colony_server: at least one worker is needed" << endl;
+        return 1;
+    }
+
+    colonyServer SERVER;
+    ServerStart(SERVER, workers);
+
+    if (!ServerListen(SERVER, argv[1])) {
+        cout << "Unable to listen on the socket " << argv[1] << "." << endl;
+        ServerStop(SERVER);
+        return 1;
+    }
+
+    stopFlag = &SERVER.stopping;
+    signal(SIGINT, StopOnSignal);
+    signal(SIGTERM, StopOnSignal);
+
+    cout << "Serving colonies on " << argv[1] << " with " << workers << " workers." << endl;
+
+    ServerRun(SERVER);
+    ServerStop(SERVER);
+
+    cout << "The server has been stopped." << endl;
+
+    return 0;
+}
@@ -0,0 +1,297 @@
+#include "snapshot.h"
+#include "mapped.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define HAVE_POSIX_FSYNC
+#endif
+
+//#define DEBUG
+
+// Bounds checked cursor over the bytes of a snapshot, ok turns false on the first read past the end
+struct snapshotReader{
+
+    const char* p;
+    const char* end;
+    bool ok;
+
+    snapshotReader(const char* b, const char* e) : p(b), end(e), ok(true) {}
+};
+
+
+
+
+/* @brief FNV-1a 64 bit hash of a block of bytes, the checksum of snapshot files.
+ *
+ * @param "hash" [in] Hash of the bytes before this block, the FNV offset basis by default, so a checksum can be built up piecewise.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+unsigned long long SnapshotChecksum(const char* data, size_t size, unsigned long long hash) {
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+
+
+/* @brief Appends an unsigned LEB128 varint.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void PutVarint(string& out, unsigned long long value) {
+
+    while (value >= 0x80) {
+        out += (char)(value | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+
+
+
+/* @brief Appends the low "bytes" bytes of a value, little endian.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static void PutFixed(string& out, unsigned long long value, int bytes) {
+
+    for (int i = 0; i < bytes; i++) {
+        out += (char)(value & 0xff);
+        value >>= 8;
+    }
+}
+
+
+
+
+/* @brief Reads an unsigned LEB128 varint (at most 10 bytes).
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static unsigned long long GetVarint(snapshotReader& in) {
+
+    unsigned long long value = 0;
+
+    for (int shift = 0; shift < 70; shift += 7) {
+        if (in.p == in.end) break;
+
+        unsigned char byte = *in.p++;
+        value |= (unsigned long long)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return value;
+    }
+
+    in.ok = false;
+    return 0;
+}
+
+
+
+
+/* @brief Reads a little endian value of "bytes" bytes.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static unsigned long long GetFixed(snapshotReader& in, int bytes) {
+
+    if (in.end - in.p < bytes) {
+        in.ok = false;
+        return 0;
+    }
+
+    unsigned long long value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (unsigned long long)(unsigned char)in.p[i] << (8 * i);
+    }
+    in.p += bytes;
+    return value;
+}
+
+
+
+
+/* @brief Writes a file in one go, into "filename.tmp" first and then renamed over filename, so an interrupted save
+ *        never leaves a half written file behind.
+ *
+ * @return false if the file could not be written, the previous file (if any) is then left untouched.
+ *
+ * @post The temporary file is flushed, synced (POSIX fsync) and closed, with every step checked, before the rename:
+ *       a full disk or an I/O error shows up here instead of as a short file renamed over the good one, and after a
+ *       crash of the machine the file is either the old one or the whole new one.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+bool WriteFileReplacing(const string& filename, const string& bytes) {
+
+    string temporary = filename + ".tmp";
+
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (file == NULL) return false;
+
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size() && fflush(file) == 0;
+
+    #ifdef HAVE_POSIX_FSYNC
+    ok = ok && fsync(fileno(file)) == 0;
+    #endif
+
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || rename(temporary.c_str(), filename.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+
+
+/* @brief Writes the whole state into a snapshot file.
+ *
+ * @param "state" [in] The colony to be saved.
+ *
+ * @param "filename" [in] Name of the snapshot file, replaced if it exists.
+ *
+ * @return COLONY_OK, or COLONY_OPEN_FAILED (detail = the file name) if it can not be written.
+ *
+ * @post The snapshot is encoded into one buffer and written with WriteFileReplacing.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonySnapshotSave(const colonyState& state, const string& filename) {
+
+    string out = "CSNP";
+    PutFixed(out, COLONY_SNAPSHOT_VERSION, 4);
+
+    long long count = 0;
+    for (stockNode* ptr = state.stockHead; ptr != NULL; ptr = ptr->next) count++;
+    PutVarint(out, count);
+
+    for (stockNode* ptr = state.stockHead; ptr != NULL; ptr = ptr->next) {
+        PutVarint(out, ptr->resourceName.size());
+        out += ptr->resourceName;
+        PutFixed(out, (unsigned long long)(long long)ptr->resourceQuantity, 8);
+    }
+
+    count = 0;
+    for (consumpNode* ptr = state.consumpHead; ptr != NULL; ptr = ptr->next) count++;
+    PutVarint(out, count);
+
+    for (consumpNode* ptr = state.consumpHead; ptr != NULL; ptr = ptr->next) {
+        out += ptr->buildType;
+        PutVarint(out, ptr->consumpQtys.size());
+        for (int q : ptr->consumpQtys) {
+            PutFixed(out, (unsigned int)q, 4);
+        }
+    }
+
+    count = 0;
+    for (colonyNode* ptr = state.colonyHead; ptr != NULL; ptr = ptr->next) count++;
+    PutVarint(out, count);
+    out.reserve(out.size() + 2 * count + 8);
+
+    for (colonyNode* ptr = state.colonyHead; ptr != NULL; ptr = ptr->next) {
+        PutVarint(out, ptr->emptyBlocks2TheLeft);
+        out += ptr->buildType;
+    }
+
+    PutFixed(out, SnapshotChecksum(out.data(), out.size()), 8);
+
+
+    if (!WriteFileReplacing(filename, out)) {
+        return colonyStatus(COLONY_OPEN_FAILED, '\0', filename);
+    }
+
+    #ifdef DEBUG
+    cout << "DEBUG: SNAPSHOT SAVED, " << out.size() << " BYTES" << endl;
+    #endif
+
+    return colonyStatus(COLONY_OK);
+}
+
+
+
+
+/* @brief Rebuilds the DLLs of a state from the bytes of a snapshot.
+ *
+ * @return false if the bytes are not a complete snapshot of this version with a matching checksum.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+static bool SnapshotDecode(const char* data, size_t size, colonyState& state) {
+
+    if (size < 16 || memcmp(data, "CSNP", 4) != 0) return false;
+
+    snapshotReader checksum(data + size - 8, data + size);
+    if (GetFixed(checksum, 8) != SnapshotChecksum(data, size - 8)) return false;
+
+    snapshotReader in(data + 4, data + size - 8);
+    if (GetFixed(in, 4) != COLONY_SNAPSHOT_VERSION) return false;
+
+    unsigned long long count = GetVarint(in);
+    for (unsigned long long i = 0; i < count && in.ok; i++) {
+
+        unsigned long long length = GetVarint(in);
+        if (!in.ok || (unsigned long long)(in.end - in.p) < length) return false;
+
+        string name(in.p, length);
+        in.p += length;
+
+        long long quantity = (long long)GetFixed(in, 8);
+        if (quantity < INT_MIN || quantity > INT_MAX) return false;
+
+        StockAddToEnd(state.stockHead, state.stockTail, name, (int)quantity);
+    }
+
+    count = GetVarint(in);
+    for (unsigned long long i = 0; i < count && in.ok; i++) {
+
+        char buildType = (char)GetFixed(in, 1);
+        unsigned long long entries = GetVarint(in);
+        if (!in.ok || (unsigned long long)(in.end - in.p) / 4 < entries) return false;
+
+        vector<int> qtys(entries);
+        for (unsigned long long k = 0; k < entries; k++) {
+            qtys[k] = (int)(unsigned int)GetFixed(in, 4);
+        }
+
+        ConsumptionAddToEnd(state.consumpHead, state.consumpTail, buildType, qtys, &state.table);
+    }
+
+    count = GetVarint(in);
+    for (unsigned long long i = 0; i < count && in.ok; i++) {
+
+        unsigned long long emptyBlocks = GetVarint(in);
+        char buildType = (char)GetFixed(in, 1);
+        if (emptyBlocks > INT_MAX) return false;
+
+        ColonyAddToEnd(state.colonyHead, state.colonyTail, buildType, (int)emptyBlocks);
+    }
+
+    return in.ok && in.p == in.end;
+}
+
+
+
+
+/* @brief Loads a snapshot written by ColonySnapshotSave into a fresh state.
+ *
+ * @param "state" [out] The state to be filled, expected to be empty.
+ *
+ * @return COLONY_OK, COLONY_OPEN_FAILED or COLONY_BAD_SNAPSHOT (detail = the file name). On failure the state is left empty.
+ *
+ * @post No recipe lookups or stock deductions are done, the stock of the snapshot already has the post-construction
+ *       balances. The positional index is rebuilt.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+colonyStatus ColonySnapshotLoad(colonyState& state, const string& filename) {
+
+    mappedFile file;
+    if (!MapFile(filename, file)) {
+        return colonyStatus(COLONY_OPEN_FAILED, '\0', filename);
+    }
+
+    bool ok = SnapshotDecode(file.data, file.size, state);
+    UnmapFile(file);
+
+    if (!ok) {
+        ColonyStateFree(state);
+        return colonyStatus(COLONY_BAD_SNAPSHOT, '\0', filename);
+    }
+
+    ColonyIndexBuild(state.colonyHead, state.index);
+
+    return colonyStatus(COLONY_OK);
+}
@@ -0,0 +1,33 @@
+// Versioned binary snapshot of a whole colony state (stock, recipes, colony)
+
+#ifndef _SNAPSHOT_
+#define _SNAPSHOT_
+
+#include <string>
+#include "colony.h"
+
+using namespace std;
+
+// Layout of a snapshot file, all integers little endian, "varint" = unsigned LEB128 (7 bits per byte, low bits first):
+//
+//   magic    "CSNP"                                  4 bytes
+//   version  COLONY_SNAPSHOT_VERSION                 4 bytes
+//   stock    varint count, then per resource:        varint name length, name bytes, 8 byte quantity
+//   recipes  varint count, then per recipe:          1 byte buildType, varint entry count, 4 bytes per entry
+//   colony   varint count, then per building:        varint emptyBlocks2TheLeft, 1 byte buildType
+//   checksum FNV-1a 64 of every byte above           8 bytes
+//
+// The stock holds the balances after construction, so loading a snapshot rebuilds the DLLs without
+// running the recipe lookups and stock deductions of ColonyLoader again.
+//------------------------------------------------------------------------------------------
+#define COLONY_SNAPSHOT_VERSION 1
+//------------------------------------------------------------------------------------------
+//
+// Function prototypes
+//------------------------------------------------------------------------------------------
+unsigned long long SnapshotChecksum(const char* data, size_t size, unsigned long long hash = 14695981039346656037ULL);
+bool WriteFileReplacing(const string& filename, const string& bytes);
+colonyStatus ColonySnapshotSave(const colonyState& state, const string& filename);
+colonyStatus ColonySnapshotLoad(colonyState& state, const string& filename);
+//------------------------------------------------------------------------------------------
+#endif